@@ -7,10 +7,21 @@
 #include <time.h>
 #include <signal.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <sys/inotify.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/signalfd.h>
 #include "cfg80211.h" //radiotap parser
 #include "ieee80211_radiotap.h"
 #include "endian_converter.h"
+#include "libairtime.h"
 #include "packet_analyzer.h"
+#include "capture_file.h"
+#include "checkpoint.h"
+#include "stage_timing.h"
+#include "frame_ring.h"
+#include "batch.h"
 /*
 //channel flags in radiotap
 #define CHANNEL_FLAG_TURBO  4
@@ -46,28 +57,1033 @@
 #define KNOWN_MCS_N_EXT_SPATIAL_STREAMS 6
 */
 
-pcap_t *handler = NULL;
+#define CHECKPOINT_FRAMES 100000 /* frames between periodic checkpoints */
 
-void alarm_handler(int sig){
-	pcap_breakloop(handler);
+#define LIVE_TIMEOUT_MS 10	/* kernel buffer block timeout */
+#define LIVE_DRAIN_MS   20	/* wait past the window end for frames stamped
+							   before it, still in the kernel buffer */
+#define LIVE_STATS_MS   100	/* capture statistics sampling period */
+
+static void usage(const char *prog){
+	fprintf(stderr, "usage: %s [options] <interface> <filter> <seconds> <output file>\n"
+					"       %s [options] -r <capture file> [filter]\n"
+					"       %s [options] -D <directory or glob> [filter]\n"
+					"options:\n"
+					"  -c <file>  write per-frame records to a columnar frame log\n"
+					"  -f         with -r, follow the capture file as it grows\n"
+					"  -k <file>  with -r, resume from and keep a checkpoint file\n"
+					"  -D <spec>  analyze every capture file of a directory or glob, one report\n"
+					"             per file in the -o directory and a summary on stdout\n"
+					"  -j <N>     with -D, files analyzed in parallel (default: one per CPU)\n"
+					"  -i <sec>   report airtime per channel and BSSID every <sec> seconds\n"
+					"  -b <bssid> count <bssid> as part of our network (repeatable)\n"
+					"  -o <file>  write interval reports to <file> instead of stderr\n"
+					"  -m <KiB>   memory cap of each analyzer table arena (default %u)\n"
+					"  -p <name>  A-MPDU timestamp convention of the driver: auto (detect),\n"
+					"             generic, broadcom, intel or qca\n"
+					"  -B <KiB>   live capture: kernel buffer size\n"
+					"  -M         live capture: immediate mode, deliver frames as they arrive\n"
+					"  -t <type>  live capture: time stamp type (host, adapter, ...)\n"
+					"  -q <slots> live capture: frames queued between the capture and the\n"
+					"             analysis thread (default %u), 0 analyzes in the capture thread\n"
+					"  -s <N>     analyze 1 PPDU in N and estimate the airtime\n"
+					"  -s <on>/<period>\n"
+					"             analyze the PPDUs starting in the first <on> ms\n"
+					"             of every <period> ms and estimate the airtime\n",
+					prog, prog, prog, ARENA_DEFAULT_CAP / 1024, RING_DEFAULT_SLOTS);
+}
+
+static volatile sig_atomic_t stop_requested = 0;
+
+/* older libpcap's filter compiler is not reentrant */
+static pthread_mutex_t compile_lock = PTHREAD_MUTEX_INITIALIZER;
+
+void stop_handler(int sig){
+	(void)sig;
+	stop_requested = 1;
+}
+
+/**
+ * install_stop_handler - stop reading capture files on SIGINT/SIGTERM.
+ */
+static void install_stop_handler(void){
+	struct sigaction sa;
+
+	/* no SA_RESTART: a stop must interrupt the inotify wait */
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = stop_handler;
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+}
+
+/**
+ * wait_for_growth - sleep until the followed file changes.
+ * @ifd: inotify descriptor watching the capture file.
+ *
+ * Return: 1 if the file was modified, 0 if it was removed or renamed
+ * (rotated) or a stop was requested, -1 on error.
+ */
+static int wait_for_growth(int ifd){
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	ssize_t len;
+	char *p;
+	int modified = 0;
+
+	len = read(ifd, buf, sizeof(buf));
+	if (len < 0)
+		return (errno == EINTR && stop_requested) ? 0 : -1;
+
+	for (p = buf; p < buf + len; p += sizeof(struct inotify_event) + ((struct inotify_event*)p)->len){
+		struct inotify_event *ev = (struct inotify_event*)p;
+		if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+			return 0;
+		if (ev->mask & (IN_MODIFY | IN_CLOSE_WRITE))
+			modified = 1;
+	}
+	return modified;
+}
+
+/**
+ * feed_pcap - hand a frame seen by libpcap or the file reader to the
+ * analyzer.
+ * @args: user's arguments.
+ * @header: pcap header of the frame.
+ * @packet: captured bytes, radiotap header included.
+ */
+static inline void feed_pcap(struct arguments *args, const struct pcap_pkthdr *header,
+							 const u_char *packet){
+	struct airtime_frame f = {
+		.ts_usec = (u_int64_t)header->ts.tv_sec * 1000000 + header->ts.tv_usec,
+		.data = packet, .caplen = header->caplen, .len = header->len};
+
+	analyzer_feed(args, &f);
+}
+
+/**
+ * analyze_file - analyze a pcap or pcapng file without libpcap's reader.
+ * Frames are passed to the analyzer straight from the file mapping.
+ * In follow mode the file is read as it grows, waking up on inotify
+ * events, until it is removed or rotated or SIGINT/SIGTERM arrives.
+ * @args: user's arguments.
+ * @path: capture file.
+ * @filter_exp: optional BPF filter, may be NULL.
+ * @follow: equal 1 to keep reading as the file grows.
+ * @checkpoint: optional checkpoint file to resume from and keep up to
+ * date, may be NULL.
+ *
+ * Return: 0 on success, otherwise the exit code.
+ */
+static int analyze_file(struct arguments *args, const char *path, const char *filter_exp,
+						u_int8_t follow, const char *checkpoint){
+	char errbuf[PCAP_ERRBUF_SIZE];
+	struct capture_file cf;
+	struct capture_frame frame;
+	struct bpf_program fp = {.bf_len = 0, .bf_insns = NULL};
+	unsigned int since_checkpoint = 0;
+	int ifd = -1;
+	int ret;
+
+	if (capture_file_open(&cf, path, errbuf) < 0){
+		fprintf(stderr, "err: %s\n", errbuf);
+		return 1;
+	}
+
+	if (filter_exp != NULL){
+		pthread_mutex_lock(&compile_lock);
+		pcap_t *dead = pcap_open_dead(DLT_IEEE802_11_RADIO, 65535);
+		if (pcap_compile(dead, &fp, filter_exp, 1, PCAP_NETMASK_UNKNOWN) == -1){
+			fprintf(stderr, "Couldn't parse filter %s: %s\n",
+			filter_exp, pcap_geterr(dead));
+			pcap_close(dead);
+			pthread_mutex_unlock(&compile_lock);
+			capture_file_close(&cf);
+			return 2;
+		}
+		pcap_close(dead);
+		pthread_mutex_unlock(&compile_lock);
+	}
+
+	if (checkpoint != NULL){
+		ret = checkpoint_load(checkpoint, &cf, args);
+		if (ret < 0){
+			fprintf(stderr, "err: %s: unusable checkpoint for %s\n", checkpoint, path);
+			ret = 5;
+			goto out;
+		}
+		if (ret)
+			fprintf(stderr, "resuming %s at offset %llu\n", path,
+					(unsigned long long)cf.offset);
+	}
+
+	if (follow){
+		/* watch before reading, so no append can be missed */
+		ifd = inotify_init1(IN_CLOEXEC);
+		if (ifd < 0 || inotify_add_watch(ifd, path,
+				IN_MODIFY | IN_CLOSE_WRITE | IN_DELETE_SELF | IN_MOVE_SELF) < 0){
+			fprintf(stderr, "err: inotify %s: %s\n", path, strerror(errno));
+			ret = 1;
+			goto out;
+		}
+	}
+
+	for (;;){
+		ret = 0;
+		while (!stop_requested){
+			/* every frame before cf.offset has been analyzed here */
+			if (checkpoint != NULL && since_checkpoint >= CHECKPOINT_FRAMES){
+				checkpoint_save(checkpoint, &cf, args);
+				since_checkpoint = 0;
+			}
+			ret = capture_file_next(&cf, &frame, errbuf);
+			if (ret != 1)
+				break;
+			since_checkpoint++;
+
+			if (frame.linktype != DLT_IEEE802_11_RADIO)
+				continue;
+			if (fp.bf_insns && !pcap_offline_filter(&fp, &frame.hdr, frame.data))
+				continue;
+			feed_pcap(args, &frame.hdr, frame.data);
+		}
+		if (ret < 0){
+			fprintf(stderr, "err: %s: %s\n", path, errbuf);
+			break;
+		}
+		if (!follow || stop_requested)
+			break;
+
+		/* caught up with the writer */
+		if (checkpoint != NULL){
+			checkpoint_save(checkpoint, &cf, args);
+			since_checkpoint = 0;
+		}
+		ret = wait_for_growth(ifd);
+		if (ret <= 0)
+			break;
+		if (capture_file_refresh(&cf) < 0){
+			fprintf(stderr, "err: %s was truncated\n", path);
+			ret = -1;
+			break;
+		}
+	}
+
+	if (checkpoint != NULL && ret >= 0 &&
+		checkpoint_save(checkpoint, &cf, args) < 0)
+		fprintf(stderr, "err: %s: %s\n", checkpoint, strerror(errno));
+	ret = ret < 0 ? 3 : 0;
+
+out:
+	if (ifd >= 0)
+		close(ifd);
+	if (fp.bf_insns)
+		pcap_freecode(&fp);
+	capture_file_close(&cf);
+	return ret;
+}
+
+/* live capture settings */
+struct live_options {
+	int buffer_size;		/* bytes, 0 = libpcap default */
+	u_int8_t immediate;
+	const char *tstamp_type;	/* NULL = libpcap default */
+	unsigned int ring_slots;	/* 0 = no analysis thread */
+};
+
+/* libpcap side of a live capture, around the analyzer */
+struct live_capture {
+	struct arguments *args;
+	pcap_t *handle;
+	pcap_dumper_t *dumper;
+	struct frame_ring *ring;		/* frames from the capture thread, optional */
+	u_int64_t window_end;			/* packet time (us) the capture stops at */
+	u_int8_t window_closed;			/* a frame stamped past window_end was seen */
+
+	/* capture statistics, sampled by the capture thread */
+	u_int32_t ps_recv;
+	u_int32_t ps_drop;
+	u_int32_t ps_ifdrop;
+	u_int8_t stats_sampled;
+
+	/* capture statistics at the last report */
+	struct pcap_stat stats;
+	u_int32_t ring_overflows;
+};
+
+/**
+ * got_packet - callback function that will be put in to pcap_loop()
+ * Save the frame to the output file and analyze it.
+ * @user: the live_capture.
+ * @header: pointer to pcap packet header.
+ * @packet: pointer to real packet (include radiotap header).
+ */
+static void got_packet(u_char *user, const struct pcap_pkthdr *header, const u_char *packet){
+	struct live_capture *live = (struct live_capture*)user;
+	/* analyzer_feed() counts the frame */
+	STAGE_MARK(t);
+	if (live->dumper != NULL)
+		pcap_dump((u_char*)(live->dumper), header, packet);
+	STAGE_END(t, STAGE_DUMP);
+	feed_pcap(live->args, header, packet);
+}
+
+/**
+ * sample_stats - read the capture statistics and publish them to
+ * report_drops(). Capture thread only: the handle is not thread-safe
+ * and is in pcap_dispatch() there.
+ * @live: live capture.
+ */
+static void sample_stats(struct live_capture *live){
+	struct pcap_stat ps;
+
+	if (pcap_stats(live->handle, &ps) < 0)
+		return;
+	__atomic_store_n(&live->ps_recv, ps.ps_recv, __ATOMIC_RELAXED);
+	__atomic_store_n(&live->ps_drop, ps.ps_drop, __ATOMIC_RELAXED);
+	__atomic_store_n(&live->ps_ifdrop, ps.ps_ifdrop, __ATOMIC_RELAXED);
+	__atomic_store_n(&live->stats_sampled, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * report_drops - report what was lost since the previous report, by the
+ * kernel and on a full frame ring. Report hook of the analyzer, so it
+ * may run on the analysis thread: it reads the statistics the capture
+ * thread last published, at most LIVE_STATS_MS old.
+ * @args: user's arguments, args->hook_ctx is the live_capture.
+ * @out: report stream.
+ */
+static void report_drops(struct arguments *args, FILE *out){
+	struct live_capture *live = args->hook_ctx;
+	struct pcap_stat ps;
+	u_int recv, drop, ifdrop;
+	u_int32_t lost = 0;
+
+	if (live->ring != NULL){
+		u_int32_t overflows = frame_ring_overflows(live->ring);
+		u_int32_t used, max_used;
+
+		used = frame_ring_occupancy(live->ring, &max_used);
+		lost = overflows - live->ring_overflows;
+		live->ring_overflows = overflows;
+		args->capture_drops += lost;
+		fprintf(out, "  ring: %u of %u slots in use, at most %u; %u frames lost to overflow\n",
+				used, live->ring->size, max_used, lost);
+	}
+
+	if (!__atomic_load_n(&live->stats_sampled, __ATOMIC_ACQUIRE)){
+		if (lost)
+			fprintf(out, "  frames were dropped: the airtime of this interval is a lower bound\n");
+		return;
+	}
+	ps.ps_recv = __atomic_load_n(&live->ps_recv, __ATOMIC_RELAXED);
+	ps.ps_drop = __atomic_load_n(&live->ps_drop, __ATOMIC_RELAXED);
+	ps.ps_ifdrop = __atomic_load_n(&live->ps_ifdrop, __ATOMIC_RELAXED);
+
+	/* the counters are cumulative and may wrap */
+	recv = ps.ps_recv - live->stats.ps_recv;
+	drop = ps.ps_drop - live->stats.ps_drop;
+	ifdrop = ps.ps_ifdrop - live->stats.ps_ifdrop;
+	live->stats = ps;
+	args->capture_drops += (u_int64_t)drop + ifdrop;
+
+	fprintf(out, "  capture: %u received, %u dropped by the kernel, %u by the interface\n",
+			recv, drop, ifdrop);
+	if (drop || ifdrop || lost)
+		fprintf(out, "  frames were dropped: the airtime of this interval is a lower bound\n");
+}
+
+/**
+ * open_live - open and activate a live capture handle.
+ * @dev: interface.
+ * @opt: capture settings.
+ * @errbuf: error message on failure.
+ *
+ * Return: the activated handle, NULL on error.
+ */
+static pcap_t *open_live(const char *dev, const struct live_options *opt, char *errbuf){
+	pcap_t *p;
+	int ret;
+
+	p = pcap_create(dev, errbuf);
+	if (p == NULL)
+		return NULL;
+
+	pcap_set_snaplen(p, BUFSIZ);
+	pcap_set_promisc(p, 0);
+	pcap_set_timeout(p, LIVE_TIMEOUT_MS);
+	if (opt->buffer_size > 0 && pcap_set_buffer_size(p, opt->buffer_size) != 0)
+		goto fail;
+	if (opt->immediate && pcap_set_immediate_mode(p, 1) != 0)
+		goto fail;
+	if (opt->tstamp_type != NULL){
+		int type = pcap_tstamp_type_name_to_val(opt->tstamp_type);
+
+		if (type < 0){
+			snprintf(errbuf, PCAP_ERRBUF_SIZE, "unknown time stamp type %s",
+					 opt->tstamp_type);
+			pcap_close(p);
+			return NULL;
+		}
+		if (pcap_set_tstamp_type(p, type) != 0)
+			goto fail;
+	}
+
+	ret = pcap_activate(p);
+	if (ret < 0)
+		goto fail;
+	if (ret > 0)
+		fprintf(stderr, "warning: %s: %s\n", dev, pcap_statustostr(ret));
+	return p;
+
+fail:
+	snprintf(errbuf, PCAP_ERRBUF_SIZE, "%s: %s", dev, pcap_geterr(p));
+	pcap_close(p);
+	return NULL;
+}
+
+/**
+ * tick - close an A-MPDU whose tail was lost when no frame comes to do
+ * it. Frames stamped up to LIVE_DRAIN_MS ago may still be on their way
+ * from the kernel. Analyzing thread only.
+ * @live: live capture.
+ */
+static void tick(struct live_capture *live){
+	struct timespec now;
+
+	clock_gettime(CLOCK_REALTIME, &now);
+	analyzer_tick(live->args, (u_int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000 -
+							  LIVE_DRAIN_MS * 1000);
+}
+
+/**
+ * window_handler - pcap_handler of the capture loop: cut the window on
+ * the packet timestamp, then queue the frame for the analysis thread or
+ * analyze it here.
+ * @user: the live_capture.
+ * @header: pointer to pcap packet header.
+ * @packet: captured bytes.
+ */
+static void window_handler(u_char *user, const struct pcap_pkthdr *header, const u_char *packet){
+	struct live_capture *live = (struct live_capture*)user;
+
+	if ((u_int64_t)header->ts.tv_sec * 1000000 + header->ts.tv_usec >= live->window_end){
+		live->window_closed = 1;
+		pcap_breakloop(live->handle);
+		return;
+	}
+	if (live->ring != NULL)
+		frame_ring_enqueue((u_char*)live->ring, header, packet);
+	else
+		got_packet(user, header, packet);
+}
+
+/**
+ * drain - read every frame libpcap has ready, without blocking.
+ * @live: live capture.
+ *
+ * Return: 0 once the buffer is empty, 1 if the window closed, -1 on error.
+ */
+static int drain(struct live_capture *live){
+	int n;
+
+	do {
+		n = pcap_dispatch(live->handle, -1, window_handler, (u_char*)live);
+		/* libpcap's buffer is handed back, publish what it held */
+		if (live->ring != NULL)
+			frame_ring_publish(live->ring);
+	} while (n > 0);
+	if (n == -1){
+		fprintf(stderr, "err: %s\n", pcap_geterr(live->handle));
+		return -1;
+	}
+	return live->window_closed ? 1 : 0;
 }
 
+/**
+ * capture_loop - capture until the window closes or SIGINT/SIGTERM.
+ * One epoll loop waits on the capture descriptor, two timerfds and a
+ * signalfd. The window is cut on packet timestamps: frames stamped at
+ * or after @live->window_end are left out. The end timer (on the
+ * realtime clock, like host timestamps) fires at the window end when
+ * the channel is quiet, and again LIVE_DRAIN_MS later, once the kernel
+ * has handed over the frames stamped before the end. The other timer
+ * samples the capture statistics every LIVE_STATS_MS, and once more on
+ * the way out; without an analysis thread it also ticks the analyzer.
+ * @live: live capture, window_end set, handle non-blocking.
+ *
+ * Return: 0 on success, -1 on error.
+ */
+static int capture_loop(struct live_capture *live){
+	struct itimerspec end = {.it_interval = {0, 0}};
+	struct itimerspec period = {
+		.it_interval = {0, LIVE_STATS_MS * 1000000},
+		.it_value = {0, LIVE_STATS_MS * 1000000},
+	};
+	struct epoll_event ev, events[4];
+	int pfd, tfd = -1, sfd = -1, stfd = -1, ep = -1;
+	u_int8_t draining = 0;
+	sigset_t stop;
+	int ret = -1, n, i;
+
+	pfd = pcap_get_selectable_fd(live->handle);
+	if (pfd < 0){
+		fprintf(stderr, "err: the capture cannot be polled\n");
+		return -1;
+	}
+
+	sigemptyset(&stop);
+	sigaddset(&stop, SIGINT);
+	sigaddset(&stop, SIGTERM);
+	end.it_value.tv_sec = live->window_end / 1000000;
+	end.it_value.tv_nsec = live->window_end % 1000000 * 1000;
+	sfd = signalfd(-1, &stop, SFD_CLOEXEC);
+	tfd = timerfd_create(CLOCK_REALTIME, TFD_CLOEXEC);
+	stfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+	ep = epoll_create1(EPOLL_CLOEXEC);
+	if (sfd < 0 || tfd < 0 || stfd < 0 || ep < 0 ||
+		timerfd_settime(tfd, TFD_TIMER_ABSTIME, &end, NULL) < 0 ||
+		timerfd_settime(stfd, 0, &period, NULL) < 0){
+		fprintf(stderr, "err: event loop: %s\n", strerror(errno));
+		goto out;
+	}
+	ev.events = EPOLLIN;
+	ev.data.fd = pfd;
+	epoll_ctl(ep, EPOLL_CTL_ADD, pfd, &ev);
+	ev.data.fd = tfd;
+	epoll_ctl(ep, EPOLL_CTL_ADD, tfd, &ev);
+	ev.data.fd = sfd;
+	epoll_ctl(ep, EPOLL_CTL_ADD, sfd, &ev);
+	ev.data.fd = stfd;
+	epoll_ctl(ep, EPOLL_CTL_ADD, stfd, &ev);
+
+	for (;;){
+		n = epoll_wait(ep, events, 4, -1);
+		if (n < 0){
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "err: event loop: %s\n", strerror(errno));
+			goto out;
+		}
+		for (i = 0; i < n; i++){
+			int fd = events[i].data.fd;
+
+			if (fd == sfd){
+				/* clean shutdown: the reports cover what was analyzed */
+				ret = 0;
+				goto out;
+			}
+			if (fd == tfd){
+				u_int64_t expirations;
+
+				if (read(tfd, &expirations, sizeof(expirations)) < 0)
+					continue;
+				if (draining){
+					ret = drain(live) < 0 ? -1 : 0;
+					goto out;
+				}
+				draining = 1;
+				end.it_value.tv_sec = 0;
+				end.it_value.tv_nsec = LIVE_DRAIN_MS * 1000000;
+				timerfd_settime(tfd, 0, &end, NULL);
+			}
+			if (fd == stfd){
+				u_int64_t expirations;
+
+				if (read(stfd, &expirations, sizeof(expirations)) >= 0){
+					sample_stats(live);
+					if (live->ring == NULL)
+						tick(live);
+				}
+			}
+			if (fd == pfd){
+				int closed = drain(live);
+
+				if (closed != 0){
+					ret = closed < 0 ? -1 : 0;
+					goto out;
+				}
+			}
+		}
+	}
+
+out:
+	/* for the last report, after the analysis thread has drained */
+	sample_stats(live);
+	if (ep >= 0)
+		close(ep);
+	if (tfd >= 0)
+		close(tfd);
+	if (stfd >= 0)
+		close(stfd);
+	if (sfd >= 0)
+		close(sfd);
+	return ret;
+}
+
+/**
+ * analysis_thread - analyze the frames queued by the capture thread
+ * until it closes the ring. The analyzer is ticked whenever the ring
+ * runs empty, at least every LIVE_STATS_MS.
+ * @arg: the live_capture, ring set.
+ *
+ * Return: NULL.
+ */
+static void *analysis_thread(void *arg){
+	struct live_capture *live = arg;
+
+	for (;;){
+		if (frame_ring_consume(live->ring, got_packet, (u_char*)live))
+			continue;
+		if (frame_ring_closed(live->ring)){
+			/* frames published before the close */
+			while (frame_ring_consume(live->ring, got_packet, (u_char*)live))
+				;
+			break;
+		}
+		frame_ring_wait(live->ring, LIVE_STATS_MS);
+		tick(live);
+	}
+	return NULL;
+}
+
+/**
+ * capture_threaded - capture in this thread and analyze in another.
+ * This thread only copies frames into the ring, so an analysis stall
+ * does not hold up draining the kernel buffer. Frames the sampler skips
+ * are copied too: the other thread dumps every frame, and the sampling
+ * decision is made there, in analyzer_feed().
+ * @live: live capture, ring set up.
+ *
+ * Return: 0 on success, -1 on error.
+ */
+static int capture_threaded(struct live_capture *live){
+	pthread_t analyzer;
+	sigset_t block, saved;
+	int n;
+
+	/* signals are for the capture thread's signalfd */
+	sigfillset(&block);
+	pthread_sigmask(SIG_BLOCK, &block, &saved);
+	n = pthread_create(&analyzer, NULL, analysis_thread, live);
+	pthread_sigmask(SIG_SETMASK, &saved, NULL);
+	if (n != 0){
+		fprintf(stderr, "err: analysis thread: %s\n", strerror(n));
+		return -1;
+	}
+
+	n = capture_loop(live);
+	frame_ring_close(live->ring);
+	pthread_join(analyzer, NULL);
+	return n;
+}
+
+/**
+ * parse_seconds - parse a duration in seconds, fractions allowed.
+ * @s: e.g. "10", "0.25".
+ * @usec: receives the duration in microseconds.
+ *
+ * Return: 0 on success, -1 if @s is not a positive number.
+ */
+static int parse_seconds(const char *s, u_int64_t *usec){
+	char *end;
+	double sec = strtod(s, &end);
+
+	if (end == s || *end != '\0' || !(sec > 0) || sec > 1e9)
+		return -1;
+	*usec = (u_int64_t)(sec * 1000000 + 0.5);
+	return *usec ? 0 : -1;
+}
+
+/**
+ * report_channel - print the channel utilization and the driver profile
+ * of the whole capture.
+ * @args: user's arguments.
+ * @out: output stream.
+ */
+static void report_channel(const struct arguments *args, FILE *out){
+	u_int64_t busy, span;
+
+	tsf_util_totals(&args->util, &busy, &span);
+	if (span)
+		fprintf(out, "channel utilization: %.1f%% (busy %llu us of %llu us TSF time)\n",
+				100.0 * busy / span, (unsigned long long)busy, (unsigned long long)span);
+	fprintf(out, "driver profile: %s\n",
+			driver_names[args->state.driver.profile == AIRTIME_DRIVER_AUTO ?
+						 AIRTIME_DRIVER_GENERIC : args->state.driver.profile]);
+}
+
+/**
+ * finish - close the outputs and print the final airtime.
+ * @args: user's arguments.
+ * @ret: exit code of the capture.
+ *
+ * Return: exit code.
+ */
+static int finish(struct arguments *args, int ret){
+	/* the subframes of the last PPDU are logged when it closes */
+	if (!ret)
+		analyzer_finish(args);
+	if (args->frame_log != NULL && frame_log_close(args->frame_log) < 0){
+		fprintf(stderr, "err: frame log: %s\n", strerror(errno));
+		if (!ret)
+			ret = 4;
+	}
+	args->frame_log = NULL;
+	if (ret)
+		return ret;
+
+	analyzer_release(args);
+	STAGE_REPORT(stderr);
+	if (args->capture_drops)
+		fprintf(stderr, "warning: %llu frames dropped during the capture, "
+						"the airtime is a lower bound\n",
+				(unsigned long long)args->capture_drops);
+	if (args->hists != NULL){
+		fprintf(args->report, "duration and size percentiles:\n");
+		duration_hists_report(args->hists, args->report);
+		duration_hists_destroy(args->hists);
+		args->hists = NULL;
+	}
+	if (args->report != stderr)
+		fclose(args->report);
+
+	/* sampling only replaces the total by the estimate, the other
+	 * summaries cover the sampled PPDUs */
+	if (args->sampler.mode != SAMPLE_OFF){
+		fprintf(stderr,"airtime of the sampled PPDUs: %llu\n",
+				(unsigned long long)args->airtime);
+		sampler_report(&args->sampler, stderr);
+	}
+	else
+		fprintf(stderr,"final airtime: %llu\n", (unsigned long long)args->airtime);
+	if (args->corrupted_airtime)
+		fprintf(stderr,"corrupted airtime: %llu\n",
+				(unsigned long long)args->corrupted_airtime);
+	if (args->responses.total_inferred)
+		fprintf(stderr,"inferred response airtime: %llu (%llu responses, not in the total)\n",
+				(unsigned long long)args->responses.total_inferred_airtime,
+				(unsigned long long)args->responses.total_inferred);
+	report_channel(args, stderr);
+	if (args->sampler.mode != SAMPLE_OFF){
+		double half_width;
+
+		printf("%.0f\n", sampler_estimate(&args->sampler, &half_width));
+		return 0;
+	}
+	printf("%llu\n", (unsigned long long)args->airtime);
+	return 0;
+}
+
+
+/* batch mode: settings shared by every file */
+struct batch_settings {
+	const struct batch_files *files;
+	const char *outdir;
+	const char *filter;
+	u_int64_t interval;
+	size_t arena_cap;
+	u_int8_t driver;
+	char **own_bssids;
+	unsigned int n_own;
+	struct batch_result *results;
+};
+
+struct batch_result {
+	int ret;					/* exit code of the file, 0 on success */
+	u_int64_t airtime;
+	unsigned int frames;
+	u_int64_t corrupted_airtime;
+	u_int64_t inferred_airtime;
+};
+
+/**
+ * batch_file - analyze one file of a batch with its own analyzer, and
+ * write its report to the output directory.
+ * The report is named after the file index and the base name, as two
+ * files of the batch may share a base name.
+ * @ctx: the batch_settings.
+ * @index: file index.
+ * @worker: worker thread number, unused.
+ */
+static void batch_file(void *ctx, unsigned int index, unsigned int worker){
+	struct batch_settings *b = ctx;
+	struct batch_result *res = &b->results[index];
+	const char *path = b->files->file[index].path;
+	const char *name = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+	char report[4096];
+	struct arguments *args;
+	unsigned int i;
+
+	(void)worker;
+	res->ret = 1;
+	args = calloc(1, sizeof(*args));
+	if (args == NULL){
+		fprintf(stderr, "err: %s: %s\n", path, strerror(errno));
+		return;
+	}
+	args->interval = b->interval;
+	args->arena_cap = b->arena_cap;
+	args->driver = b->driver;
+	if (snprintf(report, sizeof(report), "%s/%03u-%s.report", b->outdir, index, name) >= (int)sizeof(report) ||
+		(args->report = fopen(report, "w")) == NULL){
+		fprintf(stderr, "err: %s: %s\n", report, strerror(errno));
+		free(args);
+		return;
+	}
+	analyzer_init(args);
+	for (i = 0; i < b->n_own; i++)
+		channel_stats_add_own(&args->chan_stats, b->own_bssids[i]);
+	args->hists = duration_hists_create();
+
+	res->ret = analyze_file(args, path, b->filter, 0, NULL);
+	if (res->ret == 0){
+		analyzer_finish(args);
+		if (args->hists != NULL){
+			fprintf(args->report, "duration and size percentiles:\n");
+			duration_hists_report(args->hists, args->report);
+		}
+		fprintf(args->report, "final airtime: %llu\n", (unsigned long long)args->airtime);
+		report_channel(args, args->report);
+		res->airtime = args->airtime;
+		res->frames = args->state.pkt_no;
+		res->corrupted_airtime = args->corrupted_airtime;
+		res->inferred_airtime = args->responses.total_inferred_airtime;
+	}
+	if (args->hists != NULL)
+		duration_hists_destroy(args->hists);
+	analyzer_release(args);
+	fclose(args->report);
+	free(args);
+}
+
+/**
+ * run_batch - analyze the files of a directory or glob in parallel and
+ * print a summary: one line per file, in name order, then the totals.
+ * @spec: directory or glob.
+ * @b: settings, files and results are filled in here.
+ * @workers: worker threads.
+ *
+ * Return: exit code, 0 if every file was analyzed.
+ */
+static int run_batch(const char *spec, struct batch_settings *b, unsigned int workers){
+	struct batch_files files;
+	u_int64_t airtime = 0, corrupted = 0, inferred = 0, frames = 0;
+	unsigned int i, failed = 0;
+
+	if (batch_expand(spec, &files) < 0){
+		fprintf(stderr, "err: %s: %s\n", spec, strerror(errno));
+		return 1;
+	}
+	b->files = &files;
+	b->results = calloc(files.count + 1, sizeof(*b->results));
+	if (b->results == NULL || batch_run(&files, workers, batch_file, b) < 0){
+		fprintf(stderr, "err: batch: %s\n", strerror(errno));
+		free(b->results);
+		batch_free(&files);
+		return 1;
+	}
+
+	printf("# airtime (us)\tframes\tcorrupted (us)\tinferred responses (us)\tfile\n");
+	for (i = 0; i < files.count; i++){
+		const struct batch_result *res = &b->results[i];
+		if (res->ret){
+			printf("-\t-\t-\t-\t%s\n", files.file[i].path);
+			failed++;
+			continue;
+		}
+		printf("%llu\t%u\t%llu\t%llu\t%s\n", (unsigned long long)res->airtime, res->frames,
+			   (unsigned long long)res->corrupted_airtime,
+			   (unsigned long long)res->inferred_airtime, files.file[i].path);
+		airtime += res->airtime;
+		frames += res->frames;
+		corrupted += res->corrupted_airtime;
+		inferred += res->inferred_airtime;
+	}
+	printf("total\t%llu\t%llu\t%llu\t%llu\t%u files, %u failed\n",
+		   (unsigned long long)airtime, (unsigned long long)frames,
+		   (unsigned long long)corrupted, (unsigned long long)inferred,
+		   files.count, failed);
+
+	free(b->results);
+	batch_free(&files);
+	return failed ? 3 : 0;
+}
 
 int main(int argc, char *argv[]){
 
-	struct arguments args = {.dumper = NULL, .airtime = 0};
-	char *dev = argv[1];
-	char *filter_exp = argv[2];
-	unsigned int capture_duration = atoi(argv[3]);
-	char *file_save = argv[4];
+	struct arguments args = {.frame_log = NULL, .report = stderr};
+	char *read_file = NULL;
+	char *frame_log_file = NULL;
+	char *checkpoint_file = NULL;
+	char *report_file = NULL;
+	char *sample_spec = NULL;
+	char *batch_spec = NULL;
+	long workers = sysconf(_SC_NPROCESSORS_ONLN);
+	char *own_bssids[MAX_OWN_BSSIDS];
+	unsigned int n_own = 0;
+	unsigned int i;
+	struct live_options live = {.buffer_size = 0, .immediate = 0, .tstamp_type = NULL,
+								.ring_slots = RING_DEFAULT_SLOTS};
+	u_int8_t follow = 0;
+	int opt;
+	int ret = 0;
+
+	while ((opt = getopt(argc, argv, "r:c:fk:i:b:o:B:Mt:q:s:D:j:m:p:")) != -1){
+		switch (opt){
+			case 'r':
+				read_file = optarg;
+				break;
+			case 'c':
+				frame_log_file = optarg;
+				break;
+			case 'f':
+				follow = 1;
+				break;
+			case 'k':
+				checkpoint_file = optarg;
+				break;
+			case 'i':
+				args.interval = (u_int64_t)atoi(optarg) * 1000000;
+				break;
+			case 'b':
+				if (n_own == MAX_OWN_BSSIDS){
+					fprintf(stderr, "err: at most %u own BSSIDs\n", MAX_OWN_BSSIDS);
+					return 1;
+				}
+				own_bssids[n_own++] = optarg;
+				break;
+			case 'o':
+				report_file = optarg;
+				break;
+			case 'B':
+				live.buffer_size = atoi(optarg) * 1024;
+				break;
+			case 'M':
+				live.immediate = 1;
+				break;
+			case 't':
+				live.tstamp_type = optarg;
+				break;
+			case 'q':
+				live.ring_slots = atoi(optarg);
+				break;
+			case 's':
+				sample_spec = optarg;
+				break;
+			case 'D':
+				batch_spec = optarg;
+				break;
+			case 'j':
+				workers = atoi(optarg);
+				break;
+			case 'm':
+				args.arena_cap = (size_t)atoi(optarg) * 1024;
+				break;
+			case 'p':
+				if ((opt = driver_profile_parse(optarg)) < 0){
+					fprintf(stderr, "err: unknown driver profile %s\n", optarg);
+					return 1;
+				}
+				args.driver = opt;
+				break;
+			default:
+				usage(argv[0]);
+				return 1;
+		}
+	}
+
+	if (batch_spec != NULL){
+		struct batch_settings b = {.outdir = report_file ? report_file : ".",
+								   .filter = optind < argc ? argv[optind] : NULL,
+								   .interval = args.interval, .arena_cap = args.arena_cap,
+								   .driver = args.driver,
+								   .own_bssids = own_bssids, .n_own = n_own};
+		struct channel_stats check;
+
+		if (read_file || frame_log_file || follow || checkpoint_file || sample_spec){
+			usage(argv[0]);
+			return 1;
+		}
+		channel_stats_init(&check, NULL);
+		for (i = 0; i < n_own; i++){
+			if (channel_stats_add_own(&check, own_bssids[i]) < 0){
+				fprintf(stderr, "err: bad BSSID %s\n", own_bssids[i]);
+				return 1;
+			}
+		}
+		install_stop_handler();
+		return run_batch(batch_spec, &b, workers > 0 ? workers : 1);
+	}
+
+	if (read_file == NULL && (argc - optind < 4 || follow || checkpoint_file)){
+		usage(argv[0]);
+		return 1;
+	}
+	analyzer_init(&args);
+	STAGE_INIT();
+	for (i = 0; i < n_own; i++){
+		if (channel_stats_add_own(&args.chan_stats, own_bssids[i]) < 0){
+			fprintf(stderr, "err: bad BSSID %s\n", own_bssids[i]);
+			return 1;
+		}
+	}
+	if (sample_spec != NULL && sampler_parse(&args.sampler, sample_spec) < 0){
+		fprintf(stderr, "err: bad sampling %s\n", sample_spec);
+		return 1;
+	}
+	if (report_file != NULL){
+		args.report = fopen(report_file, "w");
+		if (args.report == NULL){
+			fprintf(stderr, "err: %s: %s\n", report_file, strerror(errno));
+			return 1;
+		}
+	}
+
+	args.hists = duration_hists_create();
+	if (args.hists == NULL){
+		fprintf(stderr, "err: %s\n", strerror(errno));
+		return 1;
+	}
+
+	if (frame_log_file != NULL){
+		/* a resumed run continues the log, checkpoint_load() cuts it back */
+		args.frame_log = frame_log_open(frame_log_file, checkpoint_file != NULL);
+		if (args.frame_log == NULL){
+			fprintf(stderr, "err: %s: %s\n", frame_log_file, strerror(errno));
+			return 1;
+		}
+	}
+
+	if (read_file != NULL){
+		install_stop_handler();
+		ret = analyze_file(&args, read_file,
+						   optind < argc ? argv[optind] : NULL,
+						   follow, checkpoint_file);
+		return finish(&args, ret);
+	}
+
+	char *dev = argv[optind];
+	char *filter_exp = argv[optind + 1];
+	char *file_save = argv[optind + 3];
 	char errbuf[PCAP_ERRBUF_SIZE]; //save error message when opening a device
+	u_int64_t capture_duration;
+	struct timespec now;
+	sigset_t stop;
+	pcap_t *handler;
+
+	if (parse_seconds(argv[optind + 2], &capture_duration) < 0){
+		fprintf(stderr, "err: bad capture duration %s\n", argv[optind + 2]);
+		return 1;
+	}
 
 	//open handler to capture live packets
-	handler = pcap_open_live(dev, BUFSIZ, 0, 0, errbuf);
+	handler = open_live(dev, &live, errbuf);
 	if (handler == NULL) {
 		fprintf(stderr,"err: %s\n", errbuf);
 		return 1;
 	}
+	struct live_capture live_cap = {.args = &args, .handle = handler};
+	args.report_hook = report_drops;
+	args.hook_ctx = &live_cap;
 
 	//set filter
 	struct bpf_program fp;
@@ -84,19 +1100,48 @@ int main(int argc, char *argv[]){
 	}
 
 	//open file to write packets
-	args.dumper = pcap_dump_open(handler, file_save);
+	live_cap.dumper = pcap_dump_open(handler, file_save);
+	if (live_cap.dumper == NULL){
+		/* the message names the file */
+		fprintf(stderr, "err: %s\n", pcap_geterr(handler));
+		return 1;
+	}
+
+	if (pcap_setnonblock(handler, 1, errbuf) < 0){
+		fprintf(stderr, "err: %s\n", errbuf);
+		return 1;
+	}
+	/* SIGINT/SIGTERM are read from the capture loop's signalfd */
+	sigemptyset(&stop);
+	sigaddset(&stop, SIGINT);
+	sigaddset(&stop, SIGTERM);
+	sigprocmask(SIG_BLOCK, &stop, NULL);
+
+	/* the window opens now and is cut on packet timestamps,
+	 * capture_duration later */
+	clock_gettime(CLOCK_REALTIME, &now);
+	live_cap.window_end = (u_int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000 +
+						  capture_duration;
 
-	//set alarm to stop capture after capture_duration seconds
-	alarm(capture_duration);
-	signal(SIGALRM, alarm_handler);
 	//loop through packets
-	pcap_loop(handler, 0, got_packet, (u_char*)&args);
+	struct frame_ring ring;
+	if (live.ring_slots > 0){
+		if (frame_ring_init(&ring, live.ring_slots, pcap_snapshot(handler)) < 0){
+			fprintf(stderr, "err: frame ring: %s\n", strerror(errno));
+			return 1;
+		}
+		live_cap.ring = &ring;
+		ret = capture_threaded(&live_cap) < 0 ? 1 : 0;
+	}
+	else
+		ret = capture_loop(&live_cap) < 0 ? 1 : 0;
 
-	pcap_dump_close(args.dumper);
+	/* the last interval samples the capture statistics */
+	ret = finish(&args, ret);
+	pcap_dump_close(live_cap.dumper);
 	pcap_close(handler);
+	if (live_cap.ring != NULL)
+		frame_ring_destroy(&ring);
 
-	fprintf(stderr,"final airtime: %u\n", args.airtime);
-	printf("%u\n", args.airtime);
-
-	return 0;
+	return ret;
 }
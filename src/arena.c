@@ -0,0 +1,41 @@
+#include <stdlib.h>
+#include "arena.h"
+
+/**
+ * arena_init - set up an empty arena, nothing is allocated yet.
+ * @a: arena.
+ * @cap: most bytes the arena may hold.
+ */
+void arena_init(struct arena *a, size_t cap){
+	a->base = NULL;
+	a->cap = cap;
+	a->used = 0;
+	a->overflows = 0;
+}
+
+/**
+ * arena_reserve - slow path of arena_alloc(): reserve the region on
+ * first use, or refuse an allocation past the cap.
+ * @a: arena.
+ * @size: bytes.
+ *
+ * Return: zeroed memory, NULL if it does not fit.
+ */
+void *arena_reserve(struct arena *a, size_t size){
+	if (a->base == NULL && a->cap > 0){
+		a->base = malloc(a->cap);
+		if (a->base != NULL)
+			return arena_alloc(a, size);
+	}
+	a->overflows++;
+	return NULL;
+}
+
+/**
+ * arena_destroy - release the region.
+ * @a: arena.
+ */
+void arena_destroy(struct arena *a){
+	free(a->base);
+	arena_init(a, a->cap);
+}
@@ -0,0 +1,63 @@
+#ifndef _ARENA_H
+#define _ARENA_H
+
+#include <stddef.h>
+#include <string.h>
+#include <sys/types.h>
+
+#define ARENA_ALIGN       8
+#define ARENA_DEFAULT_CAP (256 * 1024)	/* bytes per arena */
+
+/*
+ * Region allocator for analyzer tables.
+ * The whole capped region is reserved by one malloc() at the first
+ * allocation; allocations bump a pointer and are never freed one by
+ * one. An interval arena is emptied at once by arena_reset() when the
+ * report interval rolls over, a persistent arena keeps its tables for
+ * the whole capture. An allocation past the cap fails and is counted,
+ * the caller falls back to its "other" bucket instead of running out
+ * of memory.
+ */
+struct arena {
+	u_int8_t *base;
+	size_t cap;
+	size_t used;
+	u_int64_t overflows;		/* allocations refused */
+};
+
+void arena_init(struct arena *a, size_t cap);
+
+void *arena_reserve(struct arena *a, size_t size);
+
+void arena_destroy(struct arena *a);
+
+/**
+ * arena_alloc - bump-allocate zeroed memory.
+ * @a: arena, NULL allocates nothing.
+ * @size: bytes.
+ *
+ * Return: the memory, NULL if the cap is reached.
+ */
+static inline void *arena_alloc(struct arena *a, size_t size){
+	size_t start;
+
+	if (a == NULL)
+		return NULL;
+	start = (a->used + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+	if (a->base == NULL || start + size > a->cap)
+		return arena_reserve(a, size);
+	a->used = start + size;
+	memset(a->base + start, 0, size);
+	return a->base + start;
+}
+
+/**
+ * arena_reset - free every allocation at once.
+ * Memory is zeroed again as it is handed out, so this is O(1).
+ * @a: arena.
+ */
+static inline void arena_reset(struct arena *a){
+	a->used = 0;
+}
+
+#endif
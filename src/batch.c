@@ -0,0 +1,260 @@
+#include <dirent.h>
+#include <errno.h>
+#include <glob.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "batch.h"
+
+#define BATCH_CACHE_LINE 64
+
+/*
+ * Work-stealing pool over the files of a batch.
+ * Files are dealt round-robin, largest first, to one deque per worker.
+ * A worker takes its own files from the front (largest first) and,
+ * once its deque is empty, steals from the back of the others (the
+ * smallest left), so big and small files even out across workers. A
+ * task is a whole file, so each deque is guarded by a plain mutex; no
+ * task is added once the workers start, so a worker that finds every
+ * deque empty is done.
+ */
+struct batch_deque {
+	pthread_mutex_t lock;
+	unsigned int *tasks;		/* file indices */
+	unsigned int head, tail;	/* [head, tail) left */
+} __attribute__((aligned(BATCH_CACHE_LINE)));
+
+struct batch_pool {
+	const struct batch_files *files;
+	struct batch_deque *deques;
+	unsigned int workers;
+	batch_job_fn job;
+	void *ctx;
+	unsigned int steals;
+};
+
+struct batch_worker {
+	struct batch_pool *pool;
+	unsigned int id;
+};
+
+static int add_file(struct batch_files *files, const char *path){
+	struct batch_file *file;
+	struct stat st;
+
+	if (stat(path, &st) < 0 || !S_ISREG(st.st_mode))
+		return 0;
+	file = realloc(files->file, (files->count + 1) * sizeof(*file));
+	if (file == NULL)
+		return -1;
+	files->file = file;
+	if ((file[files->count].path = strdup(path)) == NULL)
+		return -1;
+	file[files->count++].size = st.st_size;
+	return 0;
+}
+
+static int compare_paths(const void *a, const void *b){
+	return strcmp(((const struct batch_file *)a)->path,
+				  ((const struct batch_file *)b)->path);
+}
+
+/**
+ * batch_expand - list the capture files of a directory or a glob.
+ * Hidden files of a directory are left out, and anything but regular
+ * files is skipped.
+ * @spec: directory, or glob(3) pattern.
+ * @files: receives the files, in name order.
+ *
+ * Return: 0 on success, -1 with errno set on error.
+ */
+int batch_expand(const char *spec, struct batch_files *files){
+	struct stat st;
+
+	memset(files, 0, sizeof(*files));
+
+	if (stat(spec, &st) == 0 && S_ISDIR(st.st_mode)){
+		DIR *dir = opendir(spec);
+		struct dirent *de;
+		char path[4096];
+
+		if (dir == NULL)
+			return -1;
+		while ((de = readdir(dir)) != NULL){
+			if (de->d_name[0] == '.')
+				continue;
+			if (snprintf(path, sizeof(path), "%s/%s", spec, de->d_name) >= (int)sizeof(path))
+				continue;
+			if (add_file(files, path) < 0){
+				closedir(dir);
+				batch_free(files);
+				return -1;
+			}
+		}
+		closedir(dir);
+	}
+	else {
+		glob_t g;
+		size_t n;
+
+		if (glob(spec, 0, NULL, &g) != 0){
+			errno = ENOENT;
+			return -1;
+		}
+		for (n = 0; n < g.gl_pathc; n++){
+			if (add_file(files, g.gl_pathv[n]) < 0){
+				globfree(&g);
+				batch_free(files);
+				return -1;
+			}
+		}
+		globfree(&g);
+	}
+
+	if (files->count > 0)
+		qsort(files->file, files->count, sizeof(*files->file), compare_paths);
+	return 0;
+}
+
+/**
+ * batch_free - free the file list.
+ * @files: file list.
+ */
+void batch_free(struct batch_files *files){
+	unsigned int i;
+
+	for (i = 0; i < files->count; i++)
+		free(files->file[i].path);
+	free(files->file);
+	memset(files, 0, sizeof(*files));
+}
+
+/**
+ * take_task - next file of a worker: its own largest, else the smallest
+ * of another worker.
+ * @pool: pool.
+ * @id: worker.
+ *
+ * Return: file index, -1 if every deque is empty.
+ */
+static int take_task(struct batch_pool *pool, unsigned int id){
+	struct batch_deque *d = &pool->deques[id];
+	unsigned int n;
+	int task = -1;
+
+	pthread_mutex_lock(&d->lock);
+	if (d->head != d->tail)
+		task = d->tasks[d->head++];
+	pthread_mutex_unlock(&d->lock);
+	if (task >= 0)
+		return task;
+
+	for (n = 1; n < pool->workers && task < 0; n++){
+		d = &pool->deques[(id + n) % pool->workers];
+		pthread_mutex_lock(&d->lock);
+		if (d->head != d->tail){
+			task = d->tasks[--d->tail];
+			__atomic_fetch_add(&pool->steals, 1, __ATOMIC_RELAXED);
+		}
+		pthread_mutex_unlock(&d->lock);
+	}
+	return task;
+}
+
+static void *worker_main(void *arg){
+	struct batch_worker *w = arg;
+	int task;
+
+	while ((task = take_task(w->pool, w->id)) >= 0)
+		w->pool->job(w->pool->ctx, task, w->id);
+	return NULL;
+}
+
+static int compare_sizes(const void *a, const void *b){
+	u_int64_t x = (*(const struct batch_file * const *)a)->size;
+	u_int64_t y = (*(const struct batch_file * const *)b)->size;
+
+	return x < y ? 1 : x > y ? -1 : 0;
+}
+
+/**
+ * batch_run - analyze every file on a work-stealing pool.
+ * @files: files of the batch.
+ * @workers: worker threads.
+ * @job: called once per file, from any worker.
+ * @ctx: first argument of @job.
+ *
+ * Return: 0 once every file was handed to @job, -1 if the workers could
+ * not be set up.
+ */
+int batch_run(const struct batch_files *files, unsigned int workers,
+			  batch_job_fn job, void *ctx){
+	struct batch_pool pool = {.files = files, .job = job, .ctx = ctx, .steals = 0};
+	const struct batch_file **order = NULL;
+	struct batch_worker *w = NULL;
+	pthread_t *threads = NULL;
+	unsigned int i, k, started = 0;
+	int ret = -1;
+
+	if (workers > files->count)
+		workers = files->count;
+	if (workers == 0)
+		workers = 1;
+	pool.workers = workers;
+
+	order = malloc((files->count + 1) * sizeof(*order));
+	pool.deques = aligned_alloc(BATCH_CACHE_LINE, workers * sizeof(*pool.deques));
+	threads = malloc(workers * sizeof(*threads));
+	w = malloc(workers * sizeof(*w));
+	if (order == NULL || pool.deques == NULL || threads == NULL || w == NULL)
+		goto out;
+	memset(pool.deques, 0, workers * sizeof(*pool.deques));
+
+	/* largest first, dealt round-robin: worker i gets the i-th, the
+	 * (i + workers)-th, ... largest file */
+	for (i = 0; i < files->count; i++)
+		order[i] = &files->file[i];
+	qsort(order, files->count, sizeof(*order), compare_sizes);
+
+	for (i = 0; i < workers; i++){
+		struct batch_deque *d = &pool.deques[i];
+
+		pthread_mutex_init(&d->lock, NULL);
+		d->tasks = malloc((files->count / workers + 1) * sizeof(*d->tasks));
+		if (d->tasks == NULL)
+			goto free_deques;
+		for (k = i; k < files->count; k += workers)
+			d->tasks[d->tail++] = order[k] - files->file;
+	}
+
+	for (i = 0; i < workers; i++){
+		w[i].pool = &pool;
+		w[i].id = i;
+		if (pthread_create(&threads[i], NULL, worker_main, &w[i]) != 0)
+			break;
+		started++;
+	}
+	/* the files of workers that did not start are stolen */
+	if (started == 0)
+		worker_main(&w[0]);
+	for (i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+
+	fprintf(stderr, "batch: %u files on %u workers, %u stolen\n",
+			files->count, started ? started : 1, pool.steals);
+	ret = 0;
+
+free_deques:
+	for (i = 0; i < workers; i++){
+		free(pool.deques[i].tasks);
+		pthread_mutex_destroy(&pool.deques[i].lock);
+	}
+out:
+	free(order);
+	free(pool.deques);
+	free(threads);
+	free(w);
+	return ret;
+}
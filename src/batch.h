@@ -0,0 +1,32 @@
+#ifndef _BATCH_H
+#define _BATCH_H
+
+#include <sys/types.h>
+
+struct batch_file {
+	char *path;
+	u_int64_t size;
+};
+
+/* capture files of a batch, in name order */
+struct batch_files {
+	struct batch_file *file;
+	unsigned int count;
+};
+
+/**
+ * batch_job_fn - analyze one file of a batch.
+ * @ctx: caller's context.
+ * @index: file index in the batch_files.
+ * @worker: worker thread number.
+ */
+typedef void (*batch_job_fn)(void *ctx, unsigned int index, unsigned int worker);
+
+int batch_expand(const char *spec, struct batch_files *files);
+
+void batch_free(struct batch_files *files);
+
+int batch_run(const struct batch_files *files, unsigned int workers,
+			  batch_job_fn job, void *ctx);
+
+#endif
@@ -0,0 +1,462 @@
+#define _FILE_OFFSET_BITS 64
+
+#include <errno.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "capture_file.h"
+#include "endian_converter.h"
+
+#define PCAP_MAGIC_USEC   0xa1b2c3d4
+#define PCAP_MAGIC_NSEC   0xa1b23c4d
+#define PCAPNG_SHB        0x0a0d0d0a /* section header block */
+#define PCAPNG_IDB        0x00000001 /* interface description block */
+#define PCAPNG_SPB        0x00000003 /* simple packet block */
+#define PCAPNG_EPB        0x00000006 /* enhanced packet block */
+#define PCAPNG_BYTE_ORDER 0x1a2b3c4d
+#define PCAPNG_OPT_TSRESOL 9
+#define PCAPNG_MAX_TSRESOL_10 19	/* 10^19 ticks/s, the most a u64 holds */
+#define PCAPNG_MAX_TSRESOL_2  63
+
+#define PCAP_FILE_HDR_LEN 24
+#define PCAP_REC_HDR_LEN  16
+#define MAX_RECORD_LEN    (256 * 1024) /* larger records mean a corrupt file */
+
+/* mapping window, kept small enough for 32 bit address spaces */
+#ifndef CAPTURE_WINDOW
+#if UINTPTR_MAX > 0xffffffff
+#define CAPTURE_WINDOW (256UL << 20)
+#else
+#define CAPTURE_WINDOW (32UL << 20)
+#endif
+#endif
+
+static inline u_int16_t file16(const struct capture_file *cf, const u_int8_t *p){
+	u_int16_t v;
+	memcpy(&v, p, sizeof(v));
+	return cf->swapped ? swap_endian_16(v) : v;
+}
+
+static inline u_int32_t file32(const struct capture_file *cf, const u_int8_t *p){
+	u_int32_t v;
+	memcpy(&v, p, sizeof(v));
+	return cf->swapped ? swap_endian_32(v) : v;
+}
+
+/**
+ * map_range - make [offset, offset + len) of the file addressable.
+ * Moves the window when the range is outside of it. The part of the file
+ * already consumed is dropped from the page cache, so reading a capture
+ * larger than memory does not evict everything else.
+ * @cf: capture file.
+ * @offset: file offset of the range.
+ * @len: range length.
+ *
+ * Return: pointer to the range, NULL if it is past the end of the file
+ * or cannot be mapped.
+ */
+static const u_int8_t *map_range(struct capture_file *cf, u_int64_t offset, size_t len){
+	long page = sysconf(_SC_PAGESIZE);
+	u_int64_t start;
+	size_t map_len;
+	void *map;
+
+	if (offset + len > cf->size)
+		return NULL;
+
+	if (cf->map && offset >= cf->map_offset &&
+		offset + len <= cf->map_offset + cf->map_len)
+		return cf->map + (offset - cf->map_offset);
+
+	if (cf->map){
+		munmap(cf->map, cf->map_len);
+		posix_fadvise(cf->fd, 0, offset & ~(u_int64_t)(page - 1),
+					  POSIX_FADV_DONTNEED);
+		cf->map = NULL;
+	}
+
+	start = offset & ~(u_int64_t)(page - 1);
+	map_len = CAPTURE_WINDOW;
+	if (map_len < offset + len - start)
+		map_len = offset + len - start;
+	if (start + map_len > cf->size)
+		map_len = cf->size - start;
+
+	map = mmap(NULL, map_len, PROT_READ, MAP_SHARED, cf->fd, start);
+	if (map == MAP_FAILED)
+		return NULL;
+	madvise(map, map_len, MADV_SEQUENTIAL);
+
+	cf->map = map;
+	cf->map_offset = start;
+	cf->map_len = map_len;
+	return cf->map + (offset - start);
+}
+
+/**
+ * read_pcapng_shb - start a new pcapng section.
+ * @cf: capture file.
+ * @block: section header block.
+ *
+ * Return: 0 on success, -1 on an unknown byte order magic.
+ */
+static int read_pcapng_shb(struct capture_file *cf, const u_int8_t *block){
+	u_int32_t bom;
+
+	memcpy(&bom, block + 8, sizeof(bom));
+	if (bom == PCAPNG_BYTE_ORDER)
+		cf->swapped = 0;
+	else if (swap_endian_32(bom) == PCAPNG_BYTE_ORDER)
+		cf->swapped = 1;
+	else
+		return -1;
+
+	/* interface ids are per section */
+	cf->n_ifaces = 0;
+	return 0;
+}
+
+/**
+ * read_pcapng_idb - register a pcapng interface and its timestamp resolution.
+ * @cf: capture file.
+ * @block: interface description block.
+ * @block_len: total block length.
+ *
+ * Return: 0 on success, -1 on a resolution the timestamps cannot be
+ * read with.
+ */
+static int read_pcapng_idb(struct capture_file *cf, const u_int8_t *block,
+							u_int32_t block_len){
+	const u_int8_t *opt = block + 16;
+	const u_int8_t *end = block + block_len - 4;
+	u_int64_t ticks = 1000000; /* default resolution: microseconds */
+
+	if (cf->n_ifaces >= CAPTURE_MAX_INTERFACES)
+		return 0;
+
+	while (opt + 4 <= end){
+		u_int16_t code = file16(cf, opt);
+		u_int16_t len = file16(cf, opt + 2);
+
+		if (code == 0 || opt + 4 + len > end)
+			break;
+		if (code == PCAPNG_OPT_TSRESOL && len == 1){
+			u_int8_t res = opt[4];
+			unsigned int i;
+
+			if (res & 0x80){
+				if ((res & 0x7f) > PCAPNG_MAX_TSRESOL_2)
+					return -1;
+				ticks = (u_int64_t)1 << (res & 0x7f);
+			}
+			else {
+				if (res > PCAPNG_MAX_TSRESOL_10)
+					return -1;
+				for (ticks = 1, i = 0; i < res; i++)
+					ticks *= 10;
+			}
+		}
+		opt += 4 + ((len + 3) & ~3);
+	}
+
+	cf->ifaces[cf->n_ifaces].linktype = file16(cf, block + 8);
+	cf->ifaces[cf->n_ifaces].ticks_per_sec = ticks;
+	cf->n_ifaces++;
+	return 0;
+}
+
+/**
+ * ticks_to_usec - microseconds in a fraction of a second.
+ * @frac: ticks past the second, less than @ticks.
+ * @ticks: ticks per second.
+ *
+ * Return: the microseconds, rounded down.
+ */
+static u_int32_t ticks_to_usec(u_int64_t frac, u_int64_t ticks){
+	u_int64_t usec;
+
+	if (ticks <= UINT64_MAX / 1000000)
+		return frac * 1000000 / ticks;
+	/* finer than 2^-44 s: divide first, off by at most 1 us */
+	usec = frac / (ticks / 1000000);
+	return usec < 1000000 ? usec : 999999;
+}
+
+/**
+ * capture_file_open - open and map a pcap or pcapng file.
+ * @cf: capture file to initialize.
+ * @path: file path.
+ * @errbuf: buffer of PCAP_ERRBUF_SIZE bytes for the error message.
+ *
+ * Return: 0 on success, -1 on error.
+ */
+int capture_file_open(struct capture_file *cf, const char *path, char *errbuf){
+	struct stat st;
+	const u_int8_t *hdr;
+	u_int32_t magic;
+
+	memset(cf, 0, sizeof(*cf));
+	cf->fd = open(path, O_RDONLY);
+	if (cf->fd < 0 || fstat(cf->fd, &st) < 0){
+		snprintf(errbuf, PCAP_ERRBUF_SIZE, "%s: %s", path, strerror(errno));
+		if (cf->fd >= 0)
+			close(cf->fd);
+		return -1;
+	}
+	cf->size = st.st_size;
+	cf->dev = st.st_dev;
+	cf->ino = st.st_ino;
+	posix_fadvise(cf->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+	hdr = map_range(cf, 0, PCAP_FILE_HDR_LEN);
+	if (hdr == NULL){
+		snprintf(errbuf, PCAP_ERRBUF_SIZE, "%s: truncated capture file", path);
+		capture_file_close(cf);
+		return -1;
+	}
+
+	memcpy(&magic, hdr, sizeof(magic));
+	if (magic == PCAPNG_SHB){
+		/* the section header is parsed by capture_file_next() */
+		cf->format = CAPTURE_FORMAT_PCAPNG;
+		return 0;
+	}
+
+	cf->format = CAPTURE_FORMAT_PCAP;
+	if (magic == PCAP_MAGIC_USEC || magic == PCAP_MAGIC_NSEC){
+		cf->swapped = 0;
+	}
+	else if (swap_endian_32(magic) == PCAP_MAGIC_USEC ||
+			 swap_endian_32(magic) == PCAP_MAGIC_NSEC){
+		cf->swapped = 1;
+		magic = swap_endian_32(magic);
+	}
+	else {
+		snprintf(errbuf, PCAP_ERRBUF_SIZE, "%s: not a pcap or pcapng file", path);
+		capture_file_close(cf);
+		return -1;
+	}
+	cf->nsec = magic == PCAP_MAGIC_NSEC;
+	cf->linktype = file32(cf, hdr + 20) & 0xffff;
+	cf->offset = PCAP_FILE_HDR_LEN;
+	return 0;
+}
+
+/**
+ * next_pcap - read the next classic pcap record.
+ *
+ * Return: 1 if a frame was read, 0 at the end of the file (or at a
+ * record that is not completely written yet), -1 on a corrupt record.
+ */
+static int next_pcap(struct capture_file *cf, struct capture_frame *frame){
+	const u_int8_t *rec = map_range(cf, cf->offset, PCAP_REC_HDR_LEN);
+	u_int32_t caplen;
+
+	if (rec == NULL)
+		return 0;
+
+	caplen = file32(cf, rec + 8);
+	if (caplen > MAX_RECORD_LEN)
+		return -1;
+
+	rec = map_range(cf, cf->offset, PCAP_REC_HDR_LEN + caplen);
+	if (rec == NULL)
+		return 0;
+
+	frame->hdr.ts.tv_sec = file32(cf, rec);
+	frame->hdr.ts.tv_usec = file32(cf, rec + 4);
+	if (cf->nsec)
+		frame->hdr.ts.tv_usec /= 1000;
+	frame->hdr.caplen = caplen;
+	frame->hdr.len = file32(cf, rec + 12);
+	frame->data = rec + PCAP_REC_HDR_LEN;
+	frame->linktype = cf->linktype;
+	frame->offset = cf->offset;
+
+	cf->offset += PCAP_REC_HDR_LEN + caplen;
+	return 1;
+}
+
+/**
+ * next_pcapng - read blocks up to the next pcapng packet block.
+ *
+ * Return: same as next_pcap().
+ */
+static int next_pcapng(struct capture_file *cf, struct capture_frame *frame){
+	for (;;){
+		const u_int8_t *block = map_range(cf, cf->offset, 12);
+		u_int32_t type, block_len;
+
+		if (block == NULL)
+			return 0;
+
+		memcpy(&type, block, sizeof(type));
+		if (type == PCAPNG_SHB){
+			/* the byte order of the block length depends on the section */
+			if (read_pcapng_shb(cf, block) < 0)
+				return -1;
+		}
+		else
+			type = file32(cf, block);
+
+		block_len = file32(cf, block + 4);
+		if (block_len < 12 || block_len > MAX_RECORD_LEN || (block_len & 3))
+			return -1;
+
+		block = map_range(cf, cf->offset, block_len);
+		if (block == NULL)
+			return 0;
+
+		if (type == PCAPNG_IDB && block_len >= 20){
+			if (read_pcapng_idb(cf, block, block_len) < 0)
+				return -1;
+		}
+		else if (type == PCAPNG_EPB && block_len >= 32){
+			u_int32_t iface = file32(cf, block + 8);
+			u_int64_t ts = (u_int64_t)file32(cf, block + 12) << 32 |
+						   file32(cf, block + 16);
+			u_int64_t ticks;
+
+			if (iface >= cf->n_ifaces)
+				return -1;
+			ticks = cf->ifaces[iface].ticks_per_sec;
+
+			frame->hdr.caplen = file32(cf, block + 20);
+			frame->hdr.len = file32(cf, block + 24);
+			if (frame->hdr.caplen > block_len - 32)
+				return -1;
+			frame->hdr.ts.tv_sec = ts / ticks;
+			frame->hdr.ts.tv_usec = ticks_to_usec(ts % ticks, ticks);
+			frame->data = block + 28;
+			frame->linktype = cf->ifaces[iface].linktype;
+			frame->offset = cf->offset;
+			cf->offset += block_len;
+			return 1;
+		}
+		else if (type == PCAPNG_SPB && block_len >= 16){
+			if (cf->n_ifaces == 0)
+				return -1;
+			frame->hdr.len = file32(cf, block + 8);
+			frame->hdr.caplen = frame->hdr.len;
+			if (frame->hdr.caplen > block_len - 16)
+				frame->hdr.caplen = block_len - 16;
+			/* simple packet blocks carry no timestamp */
+			frame->hdr.ts.tv_sec = 0;
+			frame->hdr.ts.tv_usec = 0;
+			frame->data = block + 12;
+			frame->linktype = cf->ifaces[0].linktype;
+			frame->offset = cf->offset;
+			cf->offset += block_len;
+			return 1;
+		}
+
+		cf->offset += block_len;
+	}
+}
+
+/**
+ * capture_file_next - get a zero-copy view of the next frame.
+ * @cf: capture file.
+ * @frame: filled with the frame header and a pointer into the mapping.
+ * @errbuf: buffer of PCAP_ERRBUF_SIZE bytes for the error message.
+ *
+ * Return: 1 if a frame was read, 0 at the end of the file, -1 on error.
+ * An incomplete record at the end of the file counts as the end of the
+ * file and is left unread.
+ */
+int capture_file_next(struct capture_file *cf, struct capture_frame *frame,
+					  char *errbuf){
+	int ret;
+
+	if (cf->format == CAPTURE_FORMAT_PCAPNG)
+		ret = next_pcapng(cf, frame);
+	else
+		ret = next_pcap(cf, frame);
+
+	if (ret < 0)
+		snprintf(errbuf, PCAP_ERRBUF_SIZE, "corrupt record at offset %llu",
+				 (unsigned long long)cf->offset);
+	return ret;
+}
+
+/**
+ * capture_file_refresh - pick up data appended to the file.
+ * @cf: capture file.
+ *
+ * Return: 1 if the file grew, 0 if it did not, -1 if it shrank (it was
+ * truncated or replaced) or cannot be checked.
+ */
+int capture_file_refresh(struct capture_file *cf){
+	struct stat st;
+
+	if (fstat(cf->fd, &st) < 0 || (u_int64_t)st.st_size < cf->size)
+		return -1;
+	if ((u_int64_t)st.st_size == cf->size)
+		return 0;
+	cf->size = st.st_size;
+	return 1;
+}
+
+/**
+ * capture_file_seek - continue reading at a record boundary.
+ * For pcapng the blocks before @offset are walked (headers only) to
+ * rebuild the section byte order and the interface table.
+ * @cf: capture file, just opened.
+ * @offset: file offset of a record, as found in capture_frame.offset or
+ * cf->offset.
+ *
+ * Return: 0 on success, -1 if @offset is not a record boundary.
+ */
+int capture_file_seek(struct capture_file *cf, u_int64_t offset){
+	if (cf->format == CAPTURE_FORMAT_PCAP){
+		if (offset < PCAP_FILE_HDR_LEN || offset > cf->size)
+			return -1;
+		cf->offset = offset;
+		return 0;
+	}
+
+	cf->offset = 0;
+	while (cf->offset < offset){
+		const u_int8_t *block = map_range(cf, cf->offset, 12);
+		u_int32_t type, block_len;
+
+		if (block == NULL)
+			return -1;
+		memcpy(&type, block, sizeof(type));
+		if (type == PCAPNG_SHB){
+			if (read_pcapng_shb(cf, block) < 0)
+				return -1;
+		}
+		else
+			type = file32(cf, block);
+
+		block_len = file32(cf, block + 4);
+		if (block_len < 12 || block_len > MAX_RECORD_LEN || (block_len & 3))
+			return -1;
+		if (type == PCAPNG_IDB && block_len >= 20){
+			block = map_range(cf, cf->offset, block_len);
+			if (block == NULL)
+				return -1;
+			read_pcapng_idb(cf, block, block_len);
+		}
+		cf->offset += block_len;
+	}
+	return cf->offset == offset ? 0 : -1;
+}
+
+/**
+ * capture_file_close - unmap and close a capture file.
+ * @cf: capture file.
+ */
+void capture_file_close(struct capture_file *cf){
+	if (cf->map)
+		munmap(cf->map, cf->map_len);
+	if (cf->fd >= 0)
+		close(cf->fd);
+	cf->map = NULL;
+	cf->fd = -1;
+}
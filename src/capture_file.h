@@ -0,0 +1,61 @@
+#ifndef _CAPTURE_FILE_H
+#define _CAPTURE_FILE_H
+
+#include <pcap.h>
+
+#define CAPTURE_FORMAT_PCAP   1 /* classic libpcap format */
+#define CAPTURE_FORMAT_PCAPNG 2 /* pcapng */
+
+#define CAPTURE_MAX_INTERFACES 16 /* pcapng interfaces per section */
+
+/*
+ * Memory-mapped reader for classic pcap and pcapng files.
+ * The file is mapped through a sliding window, so files larger than
+ * memory (or than the address space on 32 bit targets) can be read;
+ * records are handed out in place, without copying.
+ */
+struct capture_file {
+	int fd;
+	int format;
+	u_int64_t dev, ino;		/* file identity, for checkpoints */
+	u_int64_t size;			/* file size seen by the last refresh */
+	u_int64_t offset;		/* file offset of the next record */
+
+	/* current mapping window */
+	u_int8_t *map;
+	u_int64_t map_offset;
+	size_t map_len;
+
+	u_int8_t swapped;		/* file byte order differs from the host */
+	u_int8_t nsec;			/* classic pcap: nanosecond timestamps */
+	u_int32_t linktype;		/* classic pcap link type */
+
+	/* pcapng: interfaces of the current section */
+	unsigned int n_ifaces;
+	struct {
+		u_int32_t linktype;
+		u_int64_t ticks_per_sec;
+	} ifaces[CAPTURE_MAX_INTERFACES];
+};
+
+/* A frame view; data points into the mapping and is valid until the
+ * next call to capture_file_next() */
+struct capture_frame {
+	struct pcap_pkthdr hdr;
+	const u_char *data;
+	u_int32_t linktype;
+	u_int64_t offset;		/* file offset of the record */
+};
+
+int capture_file_open(struct capture_file *cf, const char *path, char *errbuf);
+
+int capture_file_next(struct capture_file *cf, struct capture_frame *frame,
+					  char *errbuf);
+
+int capture_file_refresh(struct capture_file *cf);
+
+int capture_file_seek(struct capture_file *cf, u_int64_t offset);
+
+void capture_file_close(struct capture_file *cf);
+
+#endif
@@ -0,0 +1,346 @@
+#include <stddef.h>
+#include <string.h>
+#include "channel_stats.h"
+
+static inline void count(struct airtime_counter *c, int duration){
+	c->airtime += duration;
+	c->frames++;
+}
+
+/**
+ * frequency_to_channel - IEEE channel number of a centre frequency.
+ * @frequency: centre frequency (MHz).
+ *
+ * Return: channel number, 0 if unknown.
+ */
+static unsigned int frequency_to_channel(u_int16_t frequency){
+	if (frequency == 2484)
+		return 14;
+	if (frequency >= 2412 && frequency < 2484)
+		return (frequency - 2407) / 5;
+	if (frequency >= 5000 && frequency < 5925)
+		return (frequency - 5000) / 5;
+	return 0;
+}
+
+static unsigned int bssid_hash(const u_int8_t *bssid){
+	/* the low bytes of a MAC address are the most random */
+	return (bssid[3] * 31 + bssid[4] * 7 + bssid[5]) % BSSID_HASH_SIZE;
+}
+
+static u_int8_t is_own(const struct channel_stats *cs, const u_int8_t *bssid){
+	unsigned int i;
+
+	for (i = 0; i < cs->n_own; i++)
+		if (memcmp(cs->own_bssids[i], bssid, 6) == 0)
+			return 1;
+	return 0;
+}
+
+/**
+ * channel_stats_init - clear the tables and the own BSSID list.
+ * @cs: channel stats.
+ * @arena: interval arena for the BSSID entries, reset along with
+ * channel_stats_reset(); NULL counts every BSSID as "other".
+ */
+void channel_stats_init(struct channel_stats *cs, struct arena *arena){
+	memset(cs, 0, sizeof(*cs));
+	cs->bssids_tail = &cs->bssids;
+	cs->gen = 1;
+	cs->arena = arena;
+}
+
+/**
+ * find_bssid - look up a BSSID of the interval, adding it if the arena
+ * has room.
+ * @cs: channel stats.
+ * @bssid: BSSID.
+ *
+ * Return: the entry, NULL if it could not be added.
+ */
+static struct bssid_entry *find_bssid(struct channel_stats *cs, const u_int8_t *bssid){
+	unsigned int h = bssid_hash(bssid);
+	struct bssid_entry *e;
+
+	if (cs->bssid_gen[h] != cs->gen){
+		cs->bssid_gen[h] = cs->gen;
+		cs->bssid_index[h] = NULL;
+	}
+	for (e = cs->bssid_index[h]; e != NULL; e = e->next)
+		if (memcmp(e->bssid, bssid, 6) == 0)
+			return e;
+
+	e = arena_alloc(cs->arena, sizeof(*e));
+	if (e == NULL)
+		return NULL;
+	memcpy(e->bssid, bssid, 6);
+	e->own = is_own(cs, bssid);
+	e->next = cs->bssid_index[h];
+	cs->bssid_index[h] = e;
+	*cs->bssids_tail = e;
+	cs->bssids_tail = &e->list;
+	cs->n_bssids++;
+	return e;
+}
+
+/**
+ * channel_stats_add_own - declare a BSSID as part of our network.
+ * @cs: channel stats.
+ * @bssid: BSSID as "aa:bb:cc:dd:ee:ff".
+ *
+ * Return: 0 on success, -1 if the BSSID is malformed or the list is full.
+ */
+int channel_stats_add_own(struct channel_stats *cs, const char *bssid){
+	unsigned int b[6];
+	unsigned int i;
+	char end;
+
+	if (cs->n_own >= MAX_OWN_BSSIDS ||
+		sscanf(bssid, "%x:%x:%x:%x:%x:%x%c", &b[0], &b[1], &b[2],
+			   &b[3], &b[4], &b[5], &end) != 6)
+		return -1;
+	for (i = 0; i < 6; i++){
+		if (b[i] > 0xff)
+			return -1;
+		cs->own_bssids[cs->n_own][i] = b[i];
+	}
+	cs->n_own++;
+	return 0;
+}
+
+/**
+ * channel_stats_account - charge a frame to its channel and BSSID.
+ * @cs: channel stats.
+ * @has_frequency: equal 1 if radiotap gave the channel.
+ * @frequency: centre frequency (MHz).
+ * @bssid: BSSID of the frame, NULL if it has none.
+ * @duration: airtime to charge (microseconds).
+ */
+void channel_stats_account(struct channel_stats *cs, u_int8_t has_frequency,
+						   u_int16_t frequency, const u_int8_t *bssid,
+						   int duration){
+	struct airtime_counter *c = &cs->other_channel;
+	unsigned int i, n;
+
+	cs->last[1] = cs->last[2] = NULL;
+	if (!has_frequency || frequency == 0)
+		c = &cs->no_channel;
+	else {
+		for (i = frequency % CHANNEL_TABLE_SIZE, n = 0; n < CHANNEL_TABLE_SIZE;
+			 i = (i + 1) % CHANNEL_TABLE_SIZE, n++){
+			struct channel_entry *e = &cs->channels[i];
+			if (e->frequency == 0){
+				if (cs->n_channels >= CHANNEL_TABLE_SIZE * 3 / 4)
+					break; /* keep probe sequences short */
+				e->frequency = frequency;
+				cs->n_channels++;
+			}
+			if (e->frequency == frequency){
+				c = &e->c;
+				break;
+			}
+		}
+	}
+	count(c, duration);
+	cs->last[0] = c;
+
+	if (bssid == NULL){
+		count(&cs->no_bssid, duration);
+		cs->last[1] = &cs->no_bssid;
+		return;
+	}
+
+	if (cs->n_own > 0){
+		c = is_own(cs, bssid) ? &cs->own : &cs->foreign;
+		count(c, duration);
+		cs->last[2] = c;
+	}
+
+	struct bssid_entry *e = find_bssid(cs, bssid);
+	c = e != NULL ? &e->c : &cs->other_bssid;
+	count(c, duration);
+	cs->last[1] = c;
+}
+
+/**
+ * channel_stats_adjust - change the airtime of the last frame, on the
+ * counters it was charged to.
+ * @cs: channel stats.
+ * @adjust: airtime to add.
+ */
+void channel_stats_adjust(struct channel_stats *cs, int adjust){
+	unsigned int i;
+
+	for (i = 0; i < 3; i++)
+		if (cs->last[i] != NULL)
+			cs->last[i]->airtime += adjust;
+}
+
+/**
+ * channel_stats_report - print the interval's channel and BSSID tables.
+ * @cs: channel stats.
+ * @out: report stream.
+ */
+void channel_stats_report(const struct channel_stats *cs, FILE *out){
+	const struct bssid_entry *b;
+	unsigned int i;
+
+	for (i = 0; i < CHANNEL_TABLE_SIZE; i++){
+		const struct channel_entry *e = &cs->channels[i];
+		if (e->frequency == 0)
+			continue;
+		fprintf(out, "  channel %u MHz (ch %u): airtime %llu us, %u frames\n",
+				e->frequency, frequency_to_channel(e->frequency),
+				(unsigned long long)e->c.airtime, e->c.frames);
+	}
+	if (cs->other_channel.frames)
+		fprintf(out, "  channel other (table full): airtime %llu us, %u frames\n",
+				(unsigned long long)cs->other_channel.airtime, cs->other_channel.frames);
+	if (cs->no_channel.frames)
+		fprintf(out, "  channel unknown: airtime %llu us, %u frames\n",
+				(unsigned long long)cs->no_channel.airtime, cs->no_channel.frames);
+
+	for (b = cs->bssids; b != NULL; b = b->list)
+		fprintf(out, "  bssid %02x:%02x:%02x:%02x:%02x:%02x%s: airtime %llu us, %u frames\n",
+				b->bssid[0], b->bssid[1], b->bssid[2],
+				b->bssid[3], b->bssid[4], b->bssid[5], b->own ? " (own)" : "",
+				(unsigned long long)b->c.airtime, b->c.frames);
+	if (cs->other_bssid.frames)
+		fprintf(out, "  bssid other (memory cap): airtime %llu us, %u frames\n",
+				(unsigned long long)cs->other_bssid.airtime, cs->other_bssid.frames);
+	if (cs->no_bssid.frames)
+		fprintf(out, "  bssid none: airtime %llu us, %u frames\n",
+				(unsigned long long)cs->no_bssid.airtime, cs->no_bssid.frames);
+
+	if (cs->n_own > 0)
+		fprintf(out, "  own network: airtime %llu us, %u frames; "
+					 "foreign: airtime %llu us, %u frames\n",
+				(unsigned long long)cs->own.airtime, cs->own.frames,
+				(unsigned long long)cs->foreign.airtime, cs->foreign.frames);
+}
+
+/**
+ * counter_code - checkpoint form of a counter last[] points to: its
+ * offset in the channel stats, or past them the BSSID's place in the
+ * order of appearance.
+ * @cs: channel stats.
+ * @c: counter, may be NULL.
+ *
+ * Return: the code, -1 for NULL.
+ */
+static int32_t counter_code(const struct channel_stats *cs, const struct airtime_counter *c){
+	const struct bssid_entry *e;
+	int32_t code = sizeof(*cs);
+
+	if (c == NULL)
+		return -1;
+	if ((const u_int8_t*)c >= (const u_int8_t*)cs && (const u_int8_t*)c < (const u_int8_t*)(cs + 1))
+		return (const u_int8_t*)c - (const u_int8_t*)cs;
+	for (e = cs->bssids; e != NULL && &e->c != c; e = e->list)
+		code++;
+	return e != NULL ? code : -1;
+}
+
+/**
+ * counter_at - counter of a counter_code().
+ * @cs: channel stats, BSSIDs restored.
+ * @code: the code.
+ *
+ * Return: the counter, NULL for -1 or a BSSID that was not restored.
+ */
+static struct airtime_counter *counter_at(struct channel_stats *cs, int32_t code){
+	struct bssid_entry *e;
+
+	if (code < 0)
+		return NULL;
+	if (code < (int32_t)offsetof(struct channel_stats, last))
+		return (struct airtime_counter*)((u_int8_t*)cs + code);
+	code -= sizeof(*cs);
+	for (e = cs->bssids; e != NULL && code > 0; e = e->list)
+		code--;
+	return e != NULL && code == 0 ? &e->c : NULL;
+}
+
+/**
+ * channel_stats_save - write the interval's tables to a checkpoint.
+ * @cs: channel stats.
+ * @fp: checkpoint stream.
+ *
+ * Return: 0 on success, -1 on a write error.
+ */
+int channel_stats_save(const struct channel_stats *cs, FILE *fp){
+	const struct bssid_entry *e;
+	int32_t last[3];
+	unsigned int i;
+
+	if (fwrite(cs, sizeof(*cs), 1, fp) != 1)
+		return -1;
+	for (e = cs->bssids; e != NULL; e = e->list)
+		if (fwrite(e, sizeof(*e), 1, fp) != 1)
+			return -1;
+	for (i = 0; i < 3; i++)
+		last[i] = counter_code(cs, cs->last[i]);
+	return fwrite(last, sizeof(last), 1, fp) == 1 ? 0 : -1;
+}
+
+/**
+ * channel_stats_load - restore the interval's tables from a checkpoint.
+ * The own BSSIDs are this run's. A BSSID past the arena cap goes to the
+ * "other" bucket.
+ * @cs: channel stats, just initialized.
+ * @fp: checkpoint stream.
+ *
+ * Return: 0 on success, -1 on a short or malformed record.
+ */
+int channel_stats_load(struct channel_stats *cs, FILE *fp){
+	struct channel_stats saved;
+	struct bssid_entry be, *e;
+	int32_t last[3];
+	unsigned int i;
+
+	if (fread(&saved, sizeof(saved), 1, fp) != 1 ||
+		saved.n_channels > CHANNEL_TABLE_SIZE)
+		return -1;
+	memcpy(cs->channels, saved.channels, sizeof(cs->channels));
+	cs->n_channels = saved.n_channels;
+	cs->other_channel = saved.other_channel;
+	cs->no_channel = saved.no_channel;
+	cs->other_bssid = saved.other_bssid;
+	cs->no_bssid = saved.no_bssid;
+	cs->own = saved.own;
+	cs->foreign = saved.foreign;
+
+	for (i = 0; i < saved.n_bssids; i++){
+		if (fread(&be, sizeof(be), 1, fp) != 1)
+			return -1;
+		e = find_bssid(cs, be.bssid);
+		if (e != NULL)
+			e->c = be.c;
+		else {
+			cs->other_bssid.airtime += be.c.airtime;
+			cs->other_bssid.frames += be.c.frames;
+		}
+	}
+
+	if (fread(last, sizeof(last), 1, fp) != 1)
+		return -1;
+	for (i = 0; i < 3; i++)
+		cs->last[i] = counter_at(cs, last[i]);
+	return 0;
+}
+
+/**
+ * channel_stats_reset - start a new interval.
+ * The own BSSID list is kept. The BSSID entries are dropped without
+ * touching them, the caller resets the interval arena.
+ * @cs: channel stats.
+ */
+void channel_stats_reset(struct channel_stats *cs){
+	memset(cs, 0, offsetof(struct channel_stats, bssid_index));
+	cs->bssids_tail = &cs->bssids;
+	if (++cs->gen == 0){
+		/* wrapped: old generations could match again */
+		memset(cs->bssid_gen, 0, sizeof(cs->bssid_gen));
+		cs->gen = 1;
+	}
+}
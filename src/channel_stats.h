@@ -0,0 +1,84 @@
+#ifndef _CHANNEL_STATS_H
+#define _CHANNEL_STATS_H
+
+#include <stdio.h>
+#include <sys/types.h>
+#include "arena.h"
+
+#define CHANNEL_TABLE_SIZE 32	/* distinct centre frequencies per interval */
+#define BSSID_HASH_SIZE    64	/* buckets of the BSSID index */
+#define MAX_OWN_BSSIDS     8
+
+struct airtime_counter {
+	u_int64_t airtime;	/* microseconds */
+	u_int32_t frames;
+};
+
+struct channel_entry {
+	u_int16_t frequency;	/* MHz, 0 = free slot */
+	struct airtime_counter c;
+};
+
+struct bssid_entry {
+	u_int8_t bssid[6];
+	u_int8_t own;
+	struct airtime_counter c;
+	struct bssid_entry *next;	/* same bucket */
+	struct bssid_entry *list;	/* next BSSID seen */
+};
+
+/*
+ * Airtime per centre frequency and per BSSID over one interval.
+ * The channel table is a fixed-size open-addressing hash table. BSSID
+ * entries come from the analyzer's interval arena and are chained from
+ * a hash index; a bucket is empty unless it was filled in the current
+ * generation, so the index is cleared at once by bumping it when the
+ * arena is reset. Frames that do not fit (table full, arena cap
+ * reached) are counted in the "other" buckets, so memory is bounded
+ * whatever leaks into the capture.
+ */
+struct channel_stats {
+	struct channel_entry channels[CHANNEL_TABLE_SIZE];
+	unsigned int n_channels;
+	unsigned int n_bssids;
+	struct bssid_entry *bssids;		/* in order of appearance */
+	struct bssid_entry **bssids_tail;
+
+	struct airtime_counter other_channel;	/* channel table full */
+	struct airtime_counter no_channel;		/* no radiotap CHANNEL field */
+	struct airtime_counter other_bssid;		/* BSSID table full */
+	struct airtime_counter no_bssid;		/* control and WDS frames */
+	struct airtime_counter own;				/* frames of our BSSIDs */
+	struct airtime_counter foreign;			/* frames of other BSSIDs */
+	struct airtime_counter *last[3];		/* charged with the last frame */
+
+	/* BSSID index, valid in generation @gen only */
+	struct bssid_entry *bssid_index[BSSID_HASH_SIZE];
+	u_int32_t bssid_gen[BSSID_HASH_SIZE];
+	u_int32_t gen;
+
+	/* configuration, kept across intervals */
+	struct arena *arena;			/* interval arena of the BSSID entries */
+	u_int8_t own_bssids[MAX_OWN_BSSIDS][6];
+	unsigned int n_own;
+};
+
+void channel_stats_init(struct channel_stats *cs, struct arena *arena);
+
+int channel_stats_add_own(struct channel_stats *cs, const char *bssid);
+
+void channel_stats_account(struct channel_stats *cs, u_int8_t has_frequency,
+						   u_int16_t frequency, const u_int8_t *bssid,
+						   int duration);
+
+void channel_stats_adjust(struct channel_stats *cs, int adjust);
+
+void channel_stats_report(const struct channel_stats *cs, FILE *out);
+
+int channel_stats_save(const struct channel_stats *cs, FILE *fp);
+
+int channel_stats_load(struct channel_stats *cs, FILE *fp);
+
+void channel_stats_reset(struct channel_stats *cs);
+
+#endif
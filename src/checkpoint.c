@@ -0,0 +1,179 @@
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "checkpoint.h"
+
+#define CHECKPOINT_MAGIC "ATCKPT"
+
+/*
+ * Fixed part of the record. It is followed by the channel stats, the
+ * retry stats with their stations and, if has_hists, the histograms,
+ * each written by its module.
+ */
+struct checkpoint {
+	char magic[8];
+	u_int32_t version;
+	u_int32_t size;				/* of this part, rejects checkpoints of other builds */
+	u_int64_t dev, ino;			/* capture file identity */
+	u_int64_t offset;			/* next record to read */
+	u_int64_t airtime;
+	u_int64_t corrupted_airtime;
+	u_int64_t capture_drops;
+
+	/* open report interval */
+	u_int64_t interval_start;
+	u_int32_t interval_no;
+	u_int64_t interval_airtime;
+	struct airtime_counter interval_corrupted;
+	struct frame_type_stats frame_types;
+	struct wmm_stats wmm;
+
+	struct response_infer responses;	/* expectation, interval and totals */
+	struct tsf_util util;		/* TSF history, interval and totals */
+	struct sampler sampler;		/* current PPDU and estimator */
+	u_int8_t has_hists;
+	u_int8_t has_frame_log;
+	u_int64_t log_frames;		/* frames in the frame log */
+	struct analyzer_state state;
+};
+
+/**
+ * checkpoint_save - atomically replace the checkpoint file.
+ * The record is written to a temporary file, flushed to disk and renamed
+ * over @path, so a crash leaves either the old or the new checkpoint.
+ * @path: checkpoint file.
+ * @cf: capture file being analyzed.
+ * @args: user's arguments holding the analyzer state and counters.
+ *
+ * Return: 0 on success, -1 on error (errno is set).
+ */
+int checkpoint_save(const char *path, const struct capture_file *cf,
+					const struct arguments *args){
+	char tmp[4096];
+	struct checkpoint ckpt;
+	FILE *fp;
+
+	if (snprintf(tmp, sizeof(tmp), "%s.tmp", path) >= (int)sizeof(tmp)){
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+
+	memset(&ckpt, 0, sizeof(ckpt));
+	memcpy(ckpt.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+	ckpt.version = CHECKPOINT_VERSION;
+	ckpt.size = sizeof(ckpt);
+	ckpt.dev = cf->dev;
+	ckpt.ino = cf->ino;
+	ckpt.offset = cf->offset;
+	ckpt.airtime = args->airtime;
+	ckpt.corrupted_airtime = args->corrupted_airtime;
+	ckpt.capture_drops = args->capture_drops;
+	ckpt.interval_start = args->interval_start;
+	ckpt.interval_no = args->interval_no;
+	ckpt.interval_airtime = args->interval_airtime;
+	ckpt.interval_corrupted = args->interval_corrupted;
+	ckpt.frame_types = args->frame_types;
+	ckpt.wmm = args->wmm;
+	ckpt.responses = args->responses;
+	ckpt.util = args->util;
+	ckpt.sampler = args->sampler;
+	ckpt.has_hists = args->hists != NULL;
+	ckpt.has_frame_log = args->frame_log != NULL;
+	ckpt.state = args->state;
+	/* the frames logged are on disk before the checkpoint points past them */
+	if (args->frame_log != NULL && frame_log_sync(args->frame_log, &ckpt.log_frames) < 0)
+		return -1;
+
+	fp = fopen(tmp, "wb");
+	if (fp == NULL)
+		return -1;
+	if (fwrite(&ckpt, sizeof(ckpt), 1, fp) != 1 ||
+		channel_stats_save(&args->chan_stats, fp) < 0 ||
+		retry_stats_save(&args->retries, fp) < 0 ||
+		(args->hists != NULL && duration_hists_save(args->hists, fp) < 0) ||
+		fflush(fp) != 0 || fsync(fileno(fp)) < 0){
+		fclose(fp);
+		unlink(tmp);
+		return -1;
+	}
+	if (fclose(fp) != 0){
+		unlink(tmp);
+		return -1;
+	}
+	return rename(tmp, path);
+}
+
+/**
+ * checkpoint_load - resume from a checkpoint file.
+ * The analysis goes on as if it had not stopped: the report interval
+ * open at the save is reported whole by this run, and the frame log is
+ * cut back to the frames logged before the save.
+ * @path: checkpoint file.
+ * @cf: capture file, just opened; positioned at the saved offset.
+ * @args: user's arguments, just initialized with the same sampling and
+ * histogram settings as the run that saved; receives the analyzer state
+ * and counters.
+ *
+ * Return: 1 if resumed, 0 if there is no checkpoint yet, -1 if the
+ * checkpoint is unreadable or belongs to another capture file or other
+ * settings.
+ */
+int checkpoint_load(const char *path, struct capture_file *cf,
+					struct arguments *args){
+	struct checkpoint ckpt;
+	const struct sampler *s = &args->sampler;
+	FILE *fp;
+	int ret = -1;
+
+	fp = fopen(path, "rb");
+	if (fp == NULL){
+		if (errno != ENOENT)
+			return -1;
+		/* starting over, drop what an earlier run logged */
+		if (args->frame_log != NULL && frame_log_rewind(args->frame_log, 0) < 0)
+			return -1;
+		return 0;
+	}
+
+	if (fread(&ckpt, sizeof(ckpt), 1, fp) != 1 ||
+		memcmp(ckpt.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0 ||
+		ckpt.version != CHECKPOINT_VERSION ||
+		ckpt.size != sizeof(ckpt))
+		goto out;
+	if (ckpt.dev != cf->dev || ckpt.ino != cf->ino)
+		goto out;
+	/* the estimate and the percentiles go on from the saved ones */
+	if (ckpt.sampler.mode != s->mode || ckpt.sampler.one_in != s->one_in ||
+		ckpt.sampler.on_usec != s->on_usec || ckpt.sampler.period_usec != s->period_usec ||
+		ckpt.has_hists != (args->hists != NULL))
+		goto out;
+	if (capture_file_seek(cf, ckpt.offset) < 0)
+		goto out;
+
+	args->state = ckpt.state;
+	args->airtime = ckpt.airtime;
+	args->corrupted_airtime = ckpt.corrupted_airtime;
+	args->capture_drops = ckpt.capture_drops;
+	args->interval_start = ckpt.interval_start;
+	args->interval_no = ckpt.interval_no;
+	args->interval_airtime = ckpt.interval_airtime;
+	args->interval_corrupted = ckpt.interval_corrupted;
+	args->frame_types = ckpt.frame_types;
+	args->wmm = ckpt.wmm;
+	args->responses = ckpt.responses;
+	args->util = ckpt.util;
+	args->sampler = ckpt.sampler;
+	if (channel_stats_load(&args->chan_stats, fp) < 0 ||
+		retry_stats_load(&args->retries, fp) < 0 ||
+		(args->hists != NULL && duration_hists_load(args->hists, fp) < 0))
+		goto out;
+	if (args->frame_log != NULL &&
+		frame_log_rewind(args->frame_log, ckpt.has_frame_log ? ckpt.log_frames : 0) < 0)
+		goto out;
+	ret = 1;
+
+out:
+	fclose(fp);
+	return ret;
+}
@@ -0,0 +1,24 @@
+#ifndef _CHECKPOINT_H
+#define _CHECKPOINT_H
+
+#include "packet_analyzer.h"
+#include "capture_file.h"
+
+/*
+ * Analysis checkpoint for a capture file.
+ * Holds the offset of the next record, the analyzer state, the
+ * accumulated counters and those of the open report interval, and the
+ * length of the frame log, so a restarted analysis continues exactly
+ * where the previous one stopped. The record is a raw image of the
+ * structures and is only meant to be read back by the same build.
+ */
+
+#define CHECKPOINT_VERSION 8
+
+int checkpoint_save(const char *path, const struct capture_file *cf,
+					const struct arguments *args);
+
+int checkpoint_load(const char *path, struct capture_file *cf,
+					struct arguments *args);
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef _DEBUG_H
+#define _DEBUG_H
+
+/*
+ * Per-frame decoding traces, built with AIRTIME_DEBUG defined
+ * (make DEBUG=1). The analyzer is a library and leaves its caller's
+ * stderr alone otherwise: pr_debug() is compiled but never taken, so
+ * its arguments stay type-checked and do not count as unused.
+ */
+
+#include <stdio.h>
+
+#ifdef AIRTIME_DEBUG
+#define AIRTIME_DEBUG_ON 1
+#else
+#define AIRTIME_DEBUG_ON 0
+#endif
+
+#define pr_debug(...) do { \
+		if (AIRTIME_DEBUG_ON) \
+			fprintf(stderr, __VA_ARGS__); \
+	} while (0)
+
+#endif
@@ -0,0 +1,91 @@
+#include <string.h>
+#include "driver_profile.h"
+
+const char *driver_names[AIRTIME_DRIVERS] = { "auto", "generic", "broadcom", "intel", "qca" };
+
+/**
+ * driver_profile_init - start probing, or use a given profile.
+ * @dp: driver profile.
+ * @profile: AIRTIME_DRIVER_*, AUTO to detect it.
+ */
+void driver_profile_init(struct driver_profile *dp, u_int8_t profile){
+	memset(dp, 0, sizeof(*dp));
+	if (profile >= AIRTIME_DRIVERS)
+		profile = AIRTIME_DRIVER_AUTO;
+	dp->profile = profile;
+	dp->forced = profile != AIRTIME_DRIVER_AUTO;
+}
+
+/**
+ * driver_profile_parse - look up a profile by name.
+ * @name: "auto", "generic", "broadcom", "intel" or "qca".
+ *
+ * Return: AIRTIME_DRIVER_*, -1 if unknown.
+ */
+int driver_profile_parse(const char *name){
+	int i;
+
+	for (i = 0; i < AIRTIME_DRIVERS; i++)
+		if (strcmp(name, driver_names[i]) == 0)
+			return i;
+	return -1;
+}
+
+/**
+ * driver_profile_observe - take an HT frame following another HT frame
+ * of the same PHY as evidence, and choose the profile once enough
+ * frames were seen.
+ * @dp: driver profile, probing.
+ * @phdr: physical header info of the frame.
+ * @prev_has_tsf: equal 1 if the previous frame has a TSF.
+ * @prev_tsf: its TSF.
+ *
+ * Return: 1 if the profile was chosen on this frame.
+ */
+int driver_profile_observe(struct driver_profile *dp, const struct ieee_802_11_phdr *phdr,
+						   u_int8_t prev_has_tsf, u_int64_t prev_tsf){
+	u_int32_t best;
+
+	if (phdr->has_tsf_timestamp && prev_has_tsf){
+		u_int64_t tsf = phdr->tsf_timestamp;
+
+		if (tsf == DRIVER_TSF_ONES)
+			dp->ones_tsf++;
+		else if (tsf == 0 && prev_tsf != 0 && prev_tsf != DRIVER_TSF_ONES)
+			dp->zero_tsf++;
+		else if (tsf == prev_tsf && tsf != 0)
+			dp->same_tsf++;
+	}
+	if (++dp->probed < DRIVER_PROBE_FRAMES)
+		return 0;
+
+	best = dp->same_tsf;
+	dp->profile = AIRTIME_DRIVER_BROADCOM;
+	if (dp->zero_tsf > best){
+		best = dp->zero_tsf;
+		dp->profile = AIRTIME_DRIVER_INTEL;
+	}
+	if (dp->ones_tsf > best){
+		best = dp->ones_tsf;
+		dp->profile = AIRTIME_DRIVER_QCA;
+	}
+	if (best == 0)
+		dp->profile = AIRTIME_DRIVER_GENERIC;
+	return 1;
+}
+
+/**
+ * driver_profile_report - print the profile in use and how it was chosen.
+ * @dp: driver profile.
+ * @out: report stream.
+ */
+void driver_profile_report(const struct driver_profile *dp, FILE *out){
+	if (dp->forced){
+		fprintf(out, "  driver profile: %s (given)\n", driver_names[dp->profile]);
+		return;
+	}
+	fprintf(out, "  driver profile: %s (%s %u HT frames: %u same TSF, %u TSF 0, %u TSF -1)\n",
+			dp->profile == AIRTIME_DRIVER_AUTO ? "generic" : driver_names[dp->profile],
+			dp->profile == AIRTIME_DRIVER_AUTO ? "still probing," : "detected from",
+			dp->probed, dp->same_tsf, dp->zero_tsf, dp->ones_tsf);
+}
@@ -0,0 +1,55 @@
+#ifndef _DRIVER_PROFILE_H
+#define _DRIVER_PROFILE_H
+
+#include <stdio.h>
+#include <sys/types.h>
+#include "libairtime.h"
+#include "ieee80211.h"
+#include "tsf_util.h"
+
+#define DRIVER_PROBE_FRAMES 256	/* HT frames observed before a profile is chosen */
+
+#define DRIVER_TSF_ONES (~0ULL)
+
+extern const char *driver_names[AIRTIME_DRIVERS];
+
+/*
+ * A-MPDU timestamp convention of the capturing driver.
+ * Broadcom stamps every subframe with the TSF of the PPDU start, Intel
+ * stamps the first subframe and gives TSF 0 to the others, QCA gives
+ * TSF -1 to every subframe but the last, which is stamped with the end
+ * of the PPDU. Unless the profile is given, consecutive HT frames are
+ * observed for evidence of each pattern; after DRIVER_PROBE_FRAMES the
+ * pattern seen most is chosen, or the generic detector (all three
+ * patterns at once) if none was seen.
+ */
+struct driver_profile {
+	u_int8_t profile;			/* AIRTIME_DRIVER_*, AUTO while probing */
+	u_int8_t forced;			/* given by the user */
+	u_int32_t probed;			/* HT frames observed */
+	u_int32_t same_tsf;			/* evidence: Broadcom */
+	u_int32_t zero_tsf;			/* Intel */
+	u_int32_t ones_tsf;			/* QCA */
+};
+
+void driver_profile_init(struct driver_profile *dp, u_int8_t profile);
+
+int driver_profile_parse(const char *name);
+
+int driver_profile_observe(struct driver_profile *dp, const struct ieee_802_11_phdr *phdr,
+						   u_int8_t prev_has_tsf, u_int64_t prev_tsf);
+
+/**
+ * driver_profile_tsf_ref - what the TSF of a frame refers to with a
+ * profile.
+ * @profile: AIRTIME_DRIVER_*.
+ *
+ * Return: TSF_REF_END for QCA, TSF_REF_START otherwise.
+ */
+static inline u_int8_t driver_profile_tsf_ref(u_int8_t profile){
+	return profile == AIRTIME_DRIVER_QCA ? TSF_REF_END : TSF_REF_START;
+}
+
+void driver_profile_report(const struct driver_profile *dp, FILE *out);
+
+#endif
@@ -0,0 +1,232 @@
+#include <stdio.h>
+#include "duration_batch.h"
+
+#if defined(HAVE_DURATION_KERNEL_AVX2)
+#include <immintrin.h>
+#endif
+#if defined(HAVE_DURATION_KERNEL_NEON)
+#include <arm_neon.h>
+#endif
+
+/*
+ * Batched frame duration kernels.
+ * All kernels evaluate the formula documented in duration_batch.h with
+ * 32 bit integers. The vector kernels have no integer divide, so the
+ * quotient is estimated in single precision and then corrected by one
+ * step in each direction using the exact integer remainder; the inputs
+ * stay below 2^25 (65535 byte frames), where the estimate is never off
+ * by more than one.
+ */
+
+static duration_kernel_t duration_kernel = NULL;
+static const char *duration_kernel_label = "none";
+
+/**
+ * duration_kernel_scalar - reference kernel, one frame at a time.
+ * @batch: batch to cost, results are written to batch->duration.
+ */
+void duration_kernel_scalar(struct duration_batch *batch){
+	unsigned int i;
+
+	for (i = 0; i < batch->count; i++){
+		u_int32_t bits = batch->length[i] * batch->byte_bits[i] +
+						 batch->overhead_bits[i];
+		u_int32_t symbols = (bits + batch->divisor[i] - 1) / batch->divisor[i];
+
+		symbols *= batch->mstbc[i];
+		batch->duration[i] = batch->preamble[i] +
+				(symbols * batch->symbol_time[i] + 5) / 10;
+	}
+}
+
+#if defined(HAVE_DURATION_KERNEL_AVX2)
+
+/* quotient and remainder of a / b for 8 lanes, see the note above */
+__attribute__((target("avx2")))
+static inline __m256i avx2_udiv(__m256i a, __m256i b, __m256i *rem){
+	__m256 fq = _mm256_div_ps(_mm256_cvtepi32_ps(a), _mm256_cvtepi32_ps(b));
+	__m256i q = _mm256_cvttps_epi32(fq);
+	__m256i r = _mm256_sub_epi32(a, _mm256_mullo_epi32(q, b));
+	__m256i low = _mm256_cmpgt_epi32(_mm256_setzero_si256(), r);
+	__m256i high;
+
+	/* estimate too big: q--, r += b */
+	q = _mm256_add_epi32(q, low);
+	r = _mm256_add_epi32(r, _mm256_and_si256(low, b));
+	/* estimate too small: q++, r -= b */
+	high = _mm256_cmpgt_epi32(r, _mm256_sub_epi32(b, _mm256_set1_epi32(1)));
+	q = _mm256_sub_epi32(q, high);
+	r = _mm256_sub_epi32(r, _mm256_and_si256(high, b));
+
+	*rem = r;
+	return q;
+}
+
+__attribute__((target("avx2")))
+static inline __m256i avx2_cost8(const struct duration_batch *batch,
+								 unsigned int i){
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i ten = _mm256_set1_epi32(10);
+	const __m256i five = _mm256_set1_epi32(5);
+	__m256i len = _mm256_load_si256((const __m256i*)&batch->length[i]);
+	__m256i byte_bits = _mm256_load_si256((const __m256i*)&batch->byte_bits[i]);
+	__m256i overhead = _mm256_load_si256((const __m256i*)&batch->overhead_bits[i]);
+	__m256i divisor = _mm256_load_si256((const __m256i*)&batch->divisor[i]);
+	__m256i mstbc = _mm256_load_si256((const __m256i*)&batch->mstbc[i]);
+	__m256i symbol_time = _mm256_load_si256((const __m256i*)&batch->symbol_time[i]);
+	__m256i preamble = _mm256_load_si256((const __m256i*)&batch->preamble[i]);
+	__m256i bits, symbols, rem, tenths;
+
+	bits = _mm256_add_epi32(_mm256_mullo_epi32(len, byte_bits), overhead);
+	symbols = avx2_udiv(bits, divisor, &rem);
+	/* round up to whole symbols */
+	symbols = _mm256_sub_epi32(symbols, _mm256_cmpgt_epi32(rem, zero));
+	symbols = _mm256_mullo_epi32(symbols, mstbc);
+	tenths = _mm256_add_epi32(_mm256_mullo_epi32(symbols, symbol_time), five);
+
+	return _mm256_add_epi32(preamble, avx2_udiv(tenths, ten, &rem));
+}
+
+/**
+ * duration_kernel_avx2 - AVX2 kernel, 16 frames per loop iteration.
+ * @batch: batch to cost, padded by duration_batch_run().
+ */
+__attribute__((target("avx2")))
+void duration_kernel_avx2(struct duration_batch *batch){
+	unsigned int i;
+
+	for (i = 0; i < batch->count; i += 16){
+		/* two independent streams keep both divide ports busy */
+		__m256i d0 = avx2_cost8(batch, i);
+		__m256i d1 = avx2_cost8(batch, i + 8);
+
+		_mm256_store_si256((__m256i*)&batch->duration[i], d0);
+		_mm256_store_si256((__m256i*)&batch->duration[i + 8], d1);
+	}
+}
+
+#endif /* HAVE_DURATION_KERNEL_AVX2 */
+
+#if defined(HAVE_DURATION_KERNEL_NEON)
+
+/* quotient and remainder of a / b for 4 lanes, see the note above */
+static inline int32x4_t neon_udiv(int32x4_t a, int32x4_t b, int32x4_t *rem){
+	float32x4_t fb = vcvtq_f32_s32(b);
+	float32x4_t recip = vrecpeq_f32(fb);
+	int32x4_t q, r;
+	int32x4_t low, high;
+
+	/* two Newton-Raphson steps give a full precision reciprocal */
+	recip = vmulq_f32(recip, vrecpsq_f32(fb, recip));
+	recip = vmulq_f32(recip, vrecpsq_f32(fb, recip));
+	q = vcvtq_s32_f32(vmulq_f32(vcvtq_f32_s32(a), recip));
+	r = vsubq_s32(a, vmulq_s32(q, b));
+
+	/* estimate too big: q--, r += b */
+	low = vreinterpretq_s32_u32(vcltq_s32(r, vdupq_n_s32(0)));
+	q = vaddq_s32(q, low);
+	r = vaddq_s32(r, vandq_s32(low, b));
+	/* estimate too small: q++, r -= b */
+	high = vreinterpretq_s32_u32(vcgeq_s32(r, b));
+	q = vsubq_s32(q, high);
+	r = vsubq_s32(r, vandq_s32(high, b));
+
+	*rem = r;
+	return q;
+}
+
+static inline int32x4_t neon_cost4(const struct duration_batch *batch,
+								   unsigned int i){
+	int32x4_t len = vreinterpretq_s32_u32(vld1q_u32(&batch->length[i]));
+	int32x4_t byte_bits = vreinterpretq_s32_u32(vld1q_u32(&batch->byte_bits[i]));
+	int32x4_t overhead = vreinterpretq_s32_u32(vld1q_u32(&batch->overhead_bits[i]));
+	int32x4_t divisor = vreinterpretq_s32_u32(vld1q_u32(&batch->divisor[i]));
+	int32x4_t mstbc = vreinterpretq_s32_u32(vld1q_u32(&batch->mstbc[i]));
+	int32x4_t symbol_time = vreinterpretq_s32_u32(vld1q_u32(&batch->symbol_time[i]));
+	int32x4_t preamble = vreinterpretq_s32_u32(vld1q_u32(&batch->preamble[i]));
+	int32x4_t bits, symbols, rem, tenths;
+
+	bits = vmlaq_s32(overhead, len, byte_bits);
+	symbols = neon_udiv(bits, divisor, &rem);
+	/* round up to whole symbols */
+	symbols = vsubq_s32(symbols,
+			vreinterpretq_s32_u32(vcgtq_s32(rem, vdupq_n_s32(0))));
+	symbols = vmulq_s32(symbols, mstbc);
+	tenths = vmlaq_s32(vdupq_n_s32(5), symbols, symbol_time);
+
+	return vaddq_s32(preamble, neon_udiv(tenths, vdupq_n_s32(10), &rem));
+}
+
+/**
+ * duration_kernel_neon - NEON kernel, 8 frames per loop iteration.
+ * @batch: batch to cost, padded by duration_batch_run().
+ */
+void duration_kernel_neon(struct duration_batch *batch){
+	unsigned int i;
+
+	for (i = 0; i < batch->count; i += 8){
+		int32x4_t d0 = neon_cost4(batch, i);
+		int32x4_t d1 = neon_cost4(batch, i + 4);
+
+		vst1q_u32(&batch->duration[i], vreinterpretq_u32_s32(d0));
+		vst1q_u32(&batch->duration[i + 4], vreinterpretq_u32_s32(d1));
+	}
+}
+
+#endif /* HAVE_DURATION_KERNEL_NEON */
+
+/**
+ * select_kernel - pick the widest kernel the running CPU supports.
+ */
+static void select_kernel(void){
+	duration_kernel = duration_kernel_scalar;
+	duration_kernel_label = "scalar";
+
+#if defined(HAVE_DURATION_KERNEL_AVX2)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")){
+		duration_kernel = duration_kernel_avx2;
+		duration_kernel_label = "avx2";
+	}
+#elif defined(HAVE_DURATION_KERNEL_NEON)
+	duration_kernel = duration_kernel_neon;
+	duration_kernel_label = "neon";
+#endif
+}
+
+/**
+ * duration_batch_run - cost every frame of the batch.
+ * Lanes past batch->count are filled with harmless parameters so the
+ * vector kernels can always work on whole registers.
+ * @batch: batch filled by duration_batch_add().
+ */
+void duration_batch_run(struct duration_batch *batch){
+	unsigned int i;
+	unsigned int padded = (batch->count + 15) & ~15u;
+
+	if (duration_kernel == NULL)
+		select_kernel();
+
+	for (i = batch->count; i < padded; i++){
+		batch->length[i] = 0;
+		batch->byte_bits[i] = 0;
+		batch->overhead_bits[i] = 0;
+		batch->divisor[i] = 1;
+		batch->mstbc[i] = 1;
+		batch->symbol_time[i] = 0;
+		batch->preamble[i] = 0;
+	}
+
+	duration_kernel(batch);
+}
+
+/**
+ * duration_batch_kernel_name - name of the kernel chosen at runtime.
+ *
+ * Return: "scalar", "avx2" or "neon".
+ */
+const char *duration_batch_kernel_name(void){
+	if (duration_kernel == NULL)
+		select_kernel();
+	return duration_kernel_label;
+}
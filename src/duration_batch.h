@@ -0,0 +1,58 @@
+#ifndef _DURATION_BATCH_H
+#define _DURATION_BATCH_H
+
+#include "ieee80211.h"
+
+/* Frames per batch; a multiple of the widest vector kernel (2 x 8 lanes). */
+#define DURATION_BATCH_MAX 64
+
+/*
+ * Batch of decoded frames reduced to the integer form shared by the
+ * legacy (11b, 11a/g) and HT duration formulas of calculate_duration():
+ *
+ *   bits     = length * byte_bits + overhead_bits
+ *   symbols  = ceil(bits / divisor) * mstbc
+ *   duration = preamble + (symbols * symbol_time + 5) / 10
+ *
+ * symbol_time is in tenths of a microsecond (10 for 11b "symbols" of one
+ * microsecond, 40 for OFDM, 36 for HT short GI).
+ * Every column is stored contiguously so the kernels can load 8 (AVX2)
+ * or 4 (NEON) frames per register.
+ */
+struct duration_batch {
+	unsigned int count;
+	u_int32_t length[DURATION_BATCH_MAX] __attribute__((aligned(32)));
+	u_int32_t byte_bits[DURATION_BATCH_MAX] __attribute__((aligned(32)));
+	u_int32_t overhead_bits[DURATION_BATCH_MAX] __attribute__((aligned(32)));
+	u_int32_t divisor[DURATION_BATCH_MAX] __attribute__((aligned(32)));
+	u_int32_t mstbc[DURATION_BATCH_MAX] __attribute__((aligned(32)));
+	u_int32_t symbol_time[DURATION_BATCH_MAX] __attribute__((aligned(32)));
+	u_int32_t preamble[DURATION_BATCH_MAX] __attribute__((aligned(32)));
+	u_int32_t duration[DURATION_BATCH_MAX] __attribute__((aligned(32)));
+};
+
+typedef void (*duration_kernel_t)(struct duration_batch *batch);
+
+int duration_batch_add(struct duration_batch *batch,
+					   struct ieee_802_11_phdr *phdr,
+					   unsigned int frame_length,
+					   u_int8_t in_aggregate,
+					   u_int8_t first_frame);
+
+void duration_batch_run(struct duration_batch *batch);
+
+const char *duration_batch_kernel_name(void);
+
+void duration_kernel_scalar(struct duration_batch *batch);
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HAVE_DURATION_KERNEL_AVX2 1
+void duration_kernel_avx2(struct duration_batch *batch);
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define HAVE_DURATION_KERNEL_NEON 1
+void duration_kernel_neon(struct duration_batch *batch);
+#endif
+
+#endif
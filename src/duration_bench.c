@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "duration_batch.h"
+
+/*
+ * duration_bench - compare the scalar duration loop with the vector
+ * kernel picked at runtime, over a random mix of 11b, 11a/g and 11n
+ * frames (A-MPDU subframes included). Both kernels are first checked
+ * against calculate_duration(), frame by frame.
+ * usage: duration_bench [batches]
+ */
+
+#define BENCH_BATCHES 4096
+#define BENCH_ROUNDS 50
+
+static const u_int8_t legacy_b_rates[] = {2, 4, 11, 22};
+static const u_int8_t legacy_ofdm_rates[] = {12, 18, 24, 36, 48, 72, 96, 108};
+
+static double now(void){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void random_frame(struct ieee_802_11_phdr *phdr, unsigned int *length,
+						 u_int8_t *in_aggregate, u_int8_t *first_frame){
+	memset(phdr, 0, sizeof(*phdr));
+	phdr->has_data_rate = 1;
+	*length = 14 + rand() % 2300;
+	*in_aggregate = 0;
+	*first_frame = 0;
+
+	switch (rand() % 4){
+		case 0:
+			phdr->phy = PHDR_802_11_PHY_11B;
+			phdr->data_rate = legacy_b_rates[rand() % 4];
+			phdr->phy_info.info_11b.has_short_preamble = 1;
+			phdr->phy_info.info_11b.short_preamble = rand() % 2;
+			break;
+		case 1:
+			phdr->phy = rand() % 2 ? PHDR_802_11_PHY_11A : PHDR_802_11_PHY_11G;
+			phdr->data_rate = legacy_ofdm_rates[rand() % 8];
+			break;
+		default:
+		{
+			struct ieee_802_11n *_n = &(phdr->phy_info.info_11n);
+			phdr->phy = PHDR_802_11_PHY_11N;
+			phdr->has_data_rate = 0;
+			_n->has_mcs_index = 1;
+			_n->mcs_index = rand() % 32;
+			_n->has_bandwidth = 1;
+			_n->bandwidth = rand() % 2;
+			_n->has_short_gi = 1;
+			_n->short_gi = rand() % 2;
+			_n->has_stbc_streams = 1;
+			_n->stbc_streams = rand() % 2;
+			*in_aggregate = rand() % 2;
+			*first_frame = *in_aggregate && rand() % 2;
+			if (*in_aggregate)
+				*length = ((*length | 3) + 1) + 4;
+			break;
+		}
+	}
+}
+
+/**
+ * check - run a kernel over every batch and compare each frame with
+ * calculate_duration().
+ * @batches: the batches.
+ * @n: number of batches.
+ * @expected: calculate_duration() of each frame, DURATION_BATCH_MAX per batch.
+ * @kernel: kernel to check.
+ * @name: kernel name, for the message.
+ *
+ * Return: 0 if every frame matches, -1 on the first mismatch.
+ */
+static int check(struct duration_batch *batches, unsigned int n,
+				 const u_int32_t *expected, duration_kernel_t kernel,
+				 const char *name){
+	unsigned int i, j;
+
+	for (i = 0; i < n; i++){
+		kernel(&batches[i]);
+		for (j = 0; j < batches[i].count; j++){
+			if (batches[i].duration[j] != expected[i * DURATION_BATCH_MAX + j]){
+				fprintf(stderr, "%s: mismatch batch %u frame %u: %u != %u\n", name, i, j,
+						batches[i].duration[j], expected[i * DURATION_BATCH_MAX + j]);
+				return -1;
+			}
+		}
+	}
+	return 0;
+}
+
+static double bench(struct duration_batch *batches, unsigned int n,
+					duration_kernel_t kernel){
+	unsigned int r, i;
+	double start = now();
+
+	for (r = 0; r < BENCH_ROUNDS; r++)
+		for (i = 0; i < n; i++)
+			kernel(&batches[i]);
+	return now() - start;
+}
+
+int main(int argc, char *argv[]){
+	unsigned int n = argc > 1 ? atoi(argv[1]) : BENCH_BATCHES;
+	struct duration_batch *batches;
+	u_int32_t *expected;
+	duration_kernel_t vector = duration_kernel_scalar;
+	unsigned int i;
+	double t_scalar, t_vector;
+	double frames;
+
+	batches = aligned_alloc(32, n * sizeof(*batches));
+	expected = malloc(n * DURATION_BATCH_MAX * sizeof(*expected));
+	if (batches == NULL || expected == NULL){
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+
+	srand(1);
+	for (i = 0; i < n; i++){
+		batches[i].count = 0;
+		while (batches[i].count < DURATION_BATCH_MAX){
+			struct ieee_802_11_phdr phdr;
+			unsigned int length;
+			u_int8_t in_aggregate, first_frame;
+			int j;
+			random_frame(&phdr, &length, &in_aggregate, &first_frame);
+			j = duration_batch_add(&batches[i], &phdr, length, in_aggregate, first_frame);
+			if (j >= 0)
+				expected[i * DURATION_BATCH_MAX + j] =
+					calculate_duration(&phdr, length, in_aggregate, first_frame);
+		}
+	}
+
+	/* resolves the runtime dispatch */
+	duration_batch_run(&batches[0]);
+#if defined(HAVE_DURATION_KERNEL_AVX2)
+	if (strcmp(duration_batch_kernel_name(), "avx2") == 0)
+		vector = duration_kernel_avx2;
+#elif defined(HAVE_DURATION_KERNEL_NEON)
+	vector = duration_kernel_neon;
+#endif
+
+	if (check(batches, n, expected, duration_kernel_scalar, "scalar") < 0 ||
+		check(batches, n, expected, vector, duration_batch_kernel_name()) < 0)
+		return 1;
+
+	frames = (double)n * DURATION_BATCH_MAX * BENCH_ROUNDS;
+	t_scalar = bench(batches, n, duration_kernel_scalar);
+	t_vector = bench(batches, n, vector);
+
+	printf("frames: %.0f\n", frames);
+	printf("scalar: %.2f ns/frame\n", t_scalar * 1e9 / frames);
+	printf("%s: %.2f ns/frame\n", duration_batch_kernel_name(), t_vector * 1e9 / frames);
+	printf("speedup: %.2fx\n", t_scalar / t_vector);
+
+	free(expected);
+	free(batches);
+	return 0;
+}
@@ -1,5 +1,8 @@
+#include <stdio.h>
 #include <math.h>
 #include "ieee80211.h"
+#include "duration_batch.h"
+#include "debug.h"
 
 #define MAX_MCS_INDEX 76
 #define PHDR_802_11_BANDWIDTH_20_MHZ   0 /* 20 MHz */
@@ -124,7 +127,7 @@ static unsigned int calculate_11n_duration(unsigned int frame_length,
 		    u_int8_t stbc_streams,
 			u_int8_t in_aggregate)
 {
-	fprintf(stderr, "....calculate_11n_duration function ............\n");
+	pr_debug("....calculate_11n_duration function ............\n");
 	unsigned int bits = 0;
 	unsigned int bits_per_symbol = 0;
 	unsigned int Mstbc = 0;
@@ -140,10 +143,10 @@ static unsigned int calculate_11n_duration(unsigned int frame_length,
 			bits += 16 + ieee80211_ht_Nes[info_n->mcs_index] * 6;
 
 		Mstbc = stbc_streams ? 2 : 1;
-		fprintf(stderr, "Mstbs: %u\n", Mstbc);
+		pr_debug("Mstbs: %u\n", Mstbc);
 		bits_per_symbol = ieee80211_ht_Dbps[info_n->mcs_index] *
 		  (info_n->bandwidth == PHDR_802_11_BANDWIDTH_40_MHZ ? 2 : 1);
-		fprintf(stderr, "bits per symbol: %u\n", bits_per_symbol);
+		pr_debug("bits per symbol: %u\n", bits_per_symbol);
 		symbols = bits / (bits_per_symbol * Mstbc);
 	} else {
 		/* TODO: handle LDPC FEC, it changes the rounding */
@@ -153,8 +156,8 @@ static unsigned int calculate_11n_duration(unsigned int frame_length,
 		symbols++;
 
 	symbols *= Mstbc;
-	fprintf(stderr, "number of symbols: %u\n", symbols);
-	fprintf(stderr, "...............................................\n");
+	pr_debug("number of symbols: %u\n", symbols);
+	pr_debug("...............................................\n");
 	return (symbols * (info_n->short_gi ? 36 : 40) + 5) / 10; /* It takes 0.5us 
 																 for the radio
 																 wave to propergate */
@@ -186,10 +189,10 @@ unsigned int calculate_duration(struct ieee_802_11_phdr *phdr,
 								unsigned int frame_length,
 								u_int8_t in_aggregate,
 								u_int8_t first_frame){
-	fprintf(stderr, ".....calculate_duration function..........\n");
+	pr_debug(".....calculate_duration function..........\n");
 	unsigned int duration = 0;
 	float data_rate = 1.0f;
-	fprintf(stderr, "phy type: %u\n", phdr->phy);
+	pr_debug("phy type: %u\n", phdr->phy);
 	
 	switch (phdr->phy){
 		case PHDR_802_11_PHY_11_FHSS:
@@ -202,7 +205,7 @@ unsigned int calculate_duration(struct ieee_802_11_phdr *phdr,
 				short_preamble = phdr->phy_info.info_11b.short_preamble;
 			u_int8_t preamble = short_preamble ? 96 : 192;
 			
-			fprintf(stderr, "preamble: %u\n", preamble);
+			pr_debug("preamble: %u\n", preamble);
 			
 			/* calculation of frame duration
 			* Things we need to know to calculate accurate duration
@@ -214,7 +217,7 @@ unsigned int calculate_duration(struct ieee_802_11_phdr *phdr,
 			if (phdr->has_data_rate)
 				data_rate = phdr->data_rate*0.5f;
 
-			fprintf(stderr, "data rate: %f\n", data_rate);
+			pr_debug("data rate: %f\n", data_rate);
 			duration = (unsigned int) ceil(preamble + frame_length*8 / data_rate);
 
 			break;
@@ -232,16 +235,16 @@ unsigned int calculate_duration(struct ieee_802_11_phdr *phdr,
 			/* preamble + signal */
 			u_int8_t preamble = 16 + 4;
 
-			fprintf(stderr, "preamble: %u\n", preamble);
+			pr_debug("preamble: %u\n", preamble);
 
 			/* 16 service bits, data and 6 tail bits */
 			unsigned int bits = 16 + 8 * frame_length + 6;
-			fprintf(stderr, "number of bits: %u\n", bits);
+			pr_debug("number of bits: %u\n", bits);
 			/* bits_per_symble = data_rate * 4 */
 			if (phdr->has_data_rate)
 				data_rate = phdr->data_rate*0.5f;
 			unsigned int symbols = (unsigned int) ceil(bits / (data_rate * 4));
-			fprintf(stderr, "number of symbols: %u\n", symbols);
+			pr_debug("number of symbols: %u\n", symbols);
 
 			duration = preamble + symbols * 4; /* 4us per symbol */
 			break;
@@ -269,7 +272,7 @@ unsigned int calculate_duration(struct ieee_802_11_phdr *phdr,
 			u_int8_t stbc_streams = 0;
 			if (info_n->has_stbc_streams)
 				stbc_streams = info_n->stbc_streams;
-			fprintf(stderr, "stbc_streams: %u\n", stbc_streams);
+			pr_debug("stbc_streams: %u\n", stbc_streams);
 
 			if (first_frame || !in_aggregate){
 				u_int8_t preamble = 32; /* assume HT-mixed */
@@ -279,14 +282,14 @@ unsigned int calculate_duration(struct ieee_802_11_phdr *phdr,
 				u_int8_t ness = 0; 
 				if (info_n->has_ness)
 					ness = info_n->ness;
-				fprintf(stderr, "ness: %u\n", ness);
+				pr_debug("ness: %u\n", ness);
 				if (ness > 3)
 					break;
 
 				/* calculate number of HT-LTF training symbols.
 				* see ieee80211n-2009 20.3.9.4.6 table 20-11 */
 				u_int8_t Nsts = ieee80211_ht_streams[info_n->mcs_index] + stbc_streams;
-				fprintf(stderr, "Nsts: %u\n", Nsts);
+				pr_debug("Nsts: %u\n", Nsts);
 				if (Nsts == 0 || Nsts - 1 > 3)
 					break;
 
@@ -301,7 +304,7 @@ unsigned int calculate_duration(struct ieee_802_11_phdr *phdr,
 					preamble = info_n->greenfield ? 24 : 32; /* not include 
 																any HT-LTF */
 				preamble += 4 * (Nhtdltf[Nsts-1] + Nhteltf[ness]);
-				fprintf(stderr, "preamble: %u\n", preamble);
+				pr_debug("preamble: %u\n", preamble);
 
 				duration += preamble;
 			}
@@ -315,6 +318,118 @@ unsigned int calculate_duration(struct ieee_802_11_phdr *phdr,
 			break;
 		}
 	}
-	fprintf(stderr, "............................................\n");
+	pr_debug("............................................\n");
 	return duration;
 }
+
+
+/**
+ * duration_batch_add - append a frame to a duration batch.
+ * Reduces the legacy and HT branches of calculate_duration() to the
+ * integer parameters described in duration_batch.h, so that the batch
+ * kernels give exactly the same result as calculate_duration().
+ * @batch: batch to append to.
+ * @phdr: pointer to phy info.
+ * @frame_length: frame length, include fcs field (byte).
+ * @in_aggregate: equal 1 if this frame is an A-MPDU subframe.
+ * @first_frame: equal 1 if this is the first subframe of the A-MPDU.
+ *
+ * Return: index of the frame in the batch, or -1 if the batch is full or
+ * the PHY is not handled by the kernels (use calculate_duration()).
+ */
+int duration_batch_add(struct duration_batch *batch,
+					   struct ieee_802_11_phdr *phdr,
+					   unsigned int frame_length,
+					   u_int8_t in_aggregate,
+					   u_int8_t first_frame){
+	unsigned int i = batch->count;
+	u_int32_t rate;
+
+	if (i >= DURATION_BATCH_MAX)
+		return -1;
+
+	/* rate in .5 Mb/s units, calculate_duration() assumes 1 Mb/s
+	 * when radiotap does not give it */
+	rate = (phdr->has_data_rate && phdr->data_rate) ? phdr->data_rate : 2;
+
+	batch->length[i] = frame_length;
+	batch->mstbc[i] = 1;
+
+	switch (phdr->phy){
+		case PHDR_802_11_PHY_11B:
+		{
+			u_int8_t short_preamble = 0;
+			if (phdr->phy_info.info_11b.has_short_preamble)
+				short_preamble = phdr->phy_info.info_11b.short_preamble;
+
+			/* preamble + ceil(8 * length / (rate / 2)) */
+			batch->preamble[i] = short_preamble ? 96 : 192;
+			batch->byte_bits[i] = 16;
+			batch->overhead_bits[i] = 0;
+			batch->divisor[i] = rate;
+			batch->symbol_time[i] = 10;
+			break;
+		}
+		case PHDR_802_11_PHY_11G:
+		case PHDR_802_11_PHY_11A:
+			/* preamble + signal, 16 service bits and 6 tail bits,
+			 * bits per symbol = 4 * rate in Mb/s */
+			batch->preamble[i] = 16 + 4;
+			batch->byte_bits[i] = 8;
+			batch->overhead_bits[i] = 16 + 6;
+			batch->divisor[i] = 2 * rate;
+			batch->symbol_time[i] = 40;
+			break;
+		case PHDR_802_11_PHY_11N:
+		{
+			static const u_int8_t Nhtdltf[4] = {1, 2, 4, 4};
+			static const u_int8_t Nhteltf[4] = {0, 1, 2, 4};
+			struct ieee_802_11n *info_n = &(phdr->phy_info.info_11n);
+			u_int8_t stbc_streams = 0;
+			u_int32_t preamble = 0;
+
+			if (info_n->mcs_index > MAX_MCS_INDEX)
+				return -1;
+			if (info_n->has_stbc_streams)
+				stbc_streams = info_n->stbc_streams;
+
+			if (first_frame || !in_aggregate){
+				u_int8_t ness = 0;
+				u_int8_t Nsts;
+
+				if (info_n->has_ness)
+					ness = info_n->ness;
+				Nsts = ieee80211_ht_streams[info_n->mcs_index] + stbc_streams;
+				if (ness > 3 || Nsts == 0 || Nsts - 1 > 3){
+					/* calculate_duration() gives up on these: cost 0 */
+					batch->preamble[i] = 0;
+					batch->byte_bits[i] = 0;
+					batch->overhead_bits[i] = 0;
+					batch->divisor[i] = 1;
+					batch->symbol_time[i] = 0;
+					break;
+				}
+				preamble = 32; /* assume HT-mixed */
+				if (info_n->has_greenfield)
+					preamble = info_n->greenfield ? 24 : 32;
+				preamble += 4 * (Nhtdltf[Nsts-1] + Nhteltf[ness]);
+			}
+
+			batch->mstbc[i] = stbc_streams ? 2 : 1;
+			batch->preamble[i] = preamble;
+			batch->byte_bits[i] = 8;
+			batch->overhead_bits[i] = in_aggregate ? 0 :
+				16 + ieee80211_ht_Nes[info_n->mcs_index] * 6;
+			batch->divisor[i] = ieee80211_ht_Dbps[info_n->mcs_index] *
+				(info_n->bandwidth == PHDR_802_11_BANDWIDTH_40_MHZ ? 2 : 1) *
+				batch->mstbc[i];
+			batch->symbol_time[i] = info_n->short_gi ? 36 : 40;
+			break;
+		}
+		default:
+			return -1;
+	}
+
+	batch->count++;
+	return i;
+}
@@ -0,0 +1,339 @@
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include "duration_hist.h"
+
+#define load_relaxed(p)     __atomic_load_n((p), __ATOMIC_RELAXED)
+#define store_relaxed(p, v) __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+
+static const u_int8_t rates_11b[HIST_KEYS_11B - 1] = { 2, 4, 11, 22 };
+static const u_int8_t rates_ofdm[HIST_KEYS_OFDM - 1] = { 12, 18, 24, 36, 48, 72, 96, 108 };
+
+/**
+ * hist_index - bucket of a value.
+ * @value: recorded value.
+ *
+ * Return: bucket index.
+ */
+static inline unsigned int hist_index(u_int32_t value){
+	unsigned int shift;
+
+	if (value >= (1u << HIST_MAX_BITS))
+		value = (1u << HIST_MAX_BITS) - 1;
+	if (value < HIST_SUB_COUNT)
+		return value;
+	shift = 31 - __builtin_clz(value) - HIST_SUB_BITS;
+	return (shift << HIST_SUB_BITS) + (value >> shift);
+}
+
+/**
+ * hist_highest - highest value counted in a bucket.
+ * @index: bucket index.
+ *
+ * Return: the value.
+ */
+static u_int32_t hist_highest(unsigned int index){
+	unsigned int shift = 0;
+
+	if (index >= 2 * HIST_SUB_COUNT)
+		shift = (index >> HIST_SUB_BITS) - 1;
+	return (((index - (shift << HIST_SUB_BITS)) + 1) << shift) - 1;
+}
+
+/**
+ * hist_record - count one value.
+ * Only the owner of @h may record into it.
+ * @h: histogram.
+ * @value: value.
+ */
+void hist_record(struct hist *h, u_int32_t value){
+	u_int32_t *c = &h->counts[hist_index(value)];
+
+	store_relaxed(c, load_relaxed(c) + 1);
+	store_relaxed(&h->total, load_relaxed(&h->total) + 1);
+	if (value > load_relaxed(&h->max))
+		store_relaxed(&h->max, value);
+}
+
+/**
+ * hist_percentile - value at a percentile.
+ * @h: histogram.
+ * @percentile: 0 to 100.
+ *
+ * Return: highest value of the bucket holding the percentile, never above
+ * the recorded max; 0 if the histogram is empty.
+ */
+u_int32_t hist_percentile(const struct hist *h, double percentile){
+	u_int64_t total = load_relaxed(&h->total);
+	u_int32_t max = load_relaxed(&h->max);
+	u_int64_t rank, seen = 0;
+	unsigned int i;
+
+	if (total == 0)
+		return 0;
+	rank = (u_int64_t)(percentile / 100.0 * total + 0.5);
+	if (rank == 0)
+		rank = 1;
+
+	for (i = 0; i < HIST_BUCKETS; i++){
+		seen += load_relaxed(&h->counts[i]);
+		if (seen >= rank)
+			return hist_highest(i) < max ? hist_highest(i) : max;
+	}
+	return max;
+}
+
+/**
+ * hist_merge - add the counts of @src to @dst.
+ * @dst: histogram, owned by the caller.
+ * @src: histogram, may be recorded into meanwhile.
+ */
+void hist_merge(struct hist *dst, const struct hist *src){
+	u_int32_t max = load_relaxed(&src->max);
+	unsigned int i;
+
+	for (i = 0; i < HIST_BUCKETS; i++)
+		dst->counts[i] += load_relaxed(&src->counts[i]);
+	dst->total += load_relaxed(&src->total);
+	if (max > dst->max)
+		dst->max = max;
+}
+
+/**
+ * duration_hists_create - allocate an empty histogram set.
+ *
+ * Return: the set, NULL if out of memory.
+ */
+struct duration_hists *duration_hists_create(void){
+	return calloc(1, sizeof(struct duration_hists));
+}
+
+void duration_hists_destroy(struct duration_hists *dh){
+	free(dh);
+}
+
+static unsigned int rate_key(const u_int8_t *rates, unsigned int n, u_int8_t rate){
+	unsigned int i;
+
+	for (i = 0; i < n; i++)
+		if (rates[i] == rate)
+			return i;
+	return n;
+}
+
+/**
+ * duration_hists_key - histogram key of a frame.
+ * @phdr: physical header info, as given to calculate_duration().
+ *
+ * Return: key, below HIST_KEYS.
+ */
+unsigned int duration_hists_key(const struct ieee_802_11_phdr *phdr){
+	u_int8_t rate = phdr->has_data_rate ? phdr->data_rate : 0;
+
+	switch (phdr->phy){
+		case PHDR_802_11_PHY_11B:
+			return HIST_KEY_11B + rate_key(rates_11b, HIST_KEYS_11B - 1, rate);
+		case PHDR_802_11_PHY_11A:
+			return HIST_KEY_11A + rate_key(rates_ofdm, HIST_KEYS_OFDM - 1, rate);
+		case PHDR_802_11_PHY_11G:
+			return HIST_KEY_11G + rate_key(rates_ofdm, HIST_KEYS_OFDM - 1, rate);
+		case PHDR_802_11_PHY_11N:
+		{
+			const struct ieee_802_11n *_n = &(phdr->phy_info.info_11n);
+			if (_n->has_mcs_index && _n->mcs_index < HIST_KEYS_11N - 1)
+				return HIST_KEY_11N + _n->mcs_index;
+			return HIST_KEY_11N + HIST_KEYS_11N - 1;
+		}
+	}
+	return HIST_KEY_OTHER;
+}
+
+/**
+ * flush_pending - record the held back frame, and the PPDU if it was an
+ * A-MPDU and is complete.
+ * @dh: histogram set.
+ * @ppdu_done: equal 1 if the PPDU is complete.
+ */
+static void flush_pending(struct duration_hists *dh, u_int8_t ppdu_done){
+	struct phy_hists *ph;
+
+	if (!dh->has_pending)
+		return;
+	ph = &dh->keys[dh->pending_key];
+	hist_record(&ph->frame_duration, dh->pending_duration);
+	hist_record(&ph->frame_length, dh->pending_length);
+	dh->has_pending = 0;
+
+	if (ppdu_done && dh->ppdu_frames > 1){
+		ph = &dh->keys[dh->ppdu_key];
+		hist_record(&ph->ampdu_duration, dh->ppdu_duration);
+		hist_record(&ph->ampdu_length, dh->ppdu_length);
+	}
+}
+
+/**
+ * duration_hists_add - account one frame.
+ * @dh: histogram set.
+ * @key: duration_hists_key() of the frame.
+ * @duration: airtime charged to the frame.
+ * @length: MPDU length.
+ * @in_aggregate: equal 1 if the frame follows the previous one in an A-MPDU.
+ */
+void duration_hists_add(struct duration_hists *dh, unsigned int key,
+						unsigned int duration, unsigned int length,
+						u_int8_t in_aggregate){
+	flush_pending(dh, !in_aggregate);
+
+	if (!in_aggregate){
+		dh->ppdu_key = key;
+		dh->ppdu_frames = 0;
+		dh->ppdu_duration = 0;
+		dh->ppdu_length = 0;
+	}
+	dh->ppdu_frames++;
+	dh->ppdu_duration += duration;
+	dh->ppdu_length += length;
+
+	dh->has_pending = 1;
+	dh->pending_key = key;
+	dh->pending_duration = duration;
+	dh->pending_length = length;
+}
+
+/**
+ * duration_hists_flush - record the last frame and PPDU, at the end of
+ * the capture.
+ * @dh: histogram set.
+ */
+void duration_hists_flush(struct duration_hists *dh){
+	flush_pending(dh, 1);
+	dh->ppdu_frames = 0;
+}
+
+/**
+ * duration_hists_save - write the histograms of the keys seen, and the
+ * frame and PPDU held back, to a checkpoint.
+ * @dh: histogram set.
+ * @fp: checkpoint stream.
+ *
+ * Return: 0 on success, -1 on a write error.
+ */
+int duration_hists_save(const struct duration_hists *dh, FILE *fp){
+	u_int16_t key;
+
+	for (key = 0; key < HIST_KEYS; key++){
+		if (dh->keys[key].frame_duration.total == 0)
+			continue;
+		if (fwrite(&key, sizeof(key), 1, fp) != 1 ||
+			fwrite(&dh->keys[key], sizeof(dh->keys[key]), 1, fp) != 1)
+			return -1;
+	}
+	/* HIST_KEYS ends the keys */
+	if (fwrite(&key, sizeof(key), 1, fp) != 1 ||
+		fwrite(&dh->has_pending, sizeof(*dh) - offsetof(struct duration_hists, has_pending),
+			   1, fp) != 1)
+		return -1;
+	return 0;
+}
+
+/**
+ * duration_hists_load - restore the histograms from a checkpoint.
+ * @dh: histogram set, empty.
+ * @fp: checkpoint stream.
+ *
+ * Return: 0 on success, -1 on a short or malformed record.
+ */
+int duration_hists_load(struct duration_hists *dh, FILE *fp){
+	u_int16_t key;
+
+	for (;;){
+		if (fread(&key, sizeof(key), 1, fp) != 1 || key > HIST_KEYS)
+			return -1;
+		if (key == HIST_KEYS)
+			break;
+		if (fread(&dh->keys[key], sizeof(dh->keys[key]), 1, fp) != 1)
+			return -1;
+	}
+	if (fread(&dh->has_pending, sizeof(*dh) - offsetof(struct duration_hists, has_pending),
+			  1, fp) != 1 ||
+		dh->pending_key >= HIST_KEYS || dh->ppdu_key >= HIST_KEYS)
+		return -1;
+	return 0;
+}
+
+/**
+ * duration_hists_merge - add the histograms of @src to @dst.
+ * Frames @src still holds back are not merged, flush it first.
+ * @dst: histogram set, owned by the caller.
+ * @src: histogram set.
+ */
+void duration_hists_merge(struct duration_hists *dst, const struct duration_hists *src){
+	unsigned int i;
+
+	for (i = 0; i < HIST_KEYS; i++){
+		if (load_relaxed(&src->keys[i].frame_duration.total) == 0)
+			continue;
+		hist_merge(&dst->keys[i].frame_duration, &src->keys[i].frame_duration);
+		hist_merge(&dst->keys[i].frame_length, &src->keys[i].frame_length);
+		hist_merge(&dst->keys[i].ampdu_duration, &src->keys[i].ampdu_duration);
+		hist_merge(&dst->keys[i].ampdu_length, &src->keys[i].ampdu_length);
+	}
+}
+
+static void key_name(unsigned int key, char *buf, size_t len){
+	if (key >= HIST_KEY_OTHER)
+		snprintf(buf, len, "other");
+	else if (key >= HIST_KEY_11N){
+		if (key - HIST_KEY_11N < HIST_KEYS_11N - 1)
+			snprintf(buf, len, "11n mcs %u", key - HIST_KEY_11N);
+		else
+			snprintf(buf, len, "11n mcs ?");
+	}
+	else {
+		const char *phy = key >= HIST_KEY_11G ? "11g" : key >= HIST_KEY_11A ? "11a" : "11b";
+		const u_int8_t *rates = key >= HIST_KEY_11A ? rates_ofdm : rates_11b;
+		unsigned int i = key - (key >= HIST_KEY_11G ? HIST_KEY_11G :
+								key >= HIST_KEY_11A ? HIST_KEY_11A : HIST_KEY_11B);
+		unsigned int n = key >= HIST_KEY_11A ? HIST_KEYS_OFDM : HIST_KEYS_11B;
+
+		if (i < n - 1)
+			snprintf(buf, len, "%s %u.%u Mb/s", phy, rates[i] / 2, rates[i] % 2 * 5);
+		else
+			snprintf(buf, len, "%s rate ?", phy);
+	}
+}
+
+static void report_hist(FILE *out, const char *what, const char *unit,
+						const struct hist *h){
+	fprintf(out, "    %-16s p50 %u, p99 %u, max %u %s\n", what,
+			hist_percentile(h, 50), hist_percentile(h, 99),
+			load_relaxed(&h->max), unit);
+}
+
+/**
+ * duration_hists_report - print the percentiles of every key seen.
+ * @dh: histogram set.
+ * @out: report stream.
+ */
+void duration_hists_report(const struct duration_hists *dh, FILE *out){
+	char name[32];
+	unsigned int i;
+
+	for (i = 0; i < HIST_KEYS; i++){
+		const struct phy_hists *ph = &dh->keys[i];
+		u_int64_t frames = load_relaxed(&ph->frame_duration.total);
+		u_int64_t ampdus = load_relaxed(&ph->ampdu_duration.total);
+
+		if (frames == 0)
+			continue;
+		key_name(i, name, sizeof(name));
+		fprintf(out, "  %s: %llu frames, %llu A-MPDUs\n", name,
+				(unsigned long long)frames, (unsigned long long)ampdus);
+		report_hist(out, "frame duration", "us", &ph->frame_duration);
+		report_hist(out, "frame size", "B", &ph->frame_length);
+		if (ampdus == 0)
+			continue;
+		report_hist(out, "A-MPDU duration", "us", &ph->ampdu_duration);
+		report_hist(out, "A-MPDU size", "B", &ph->ampdu_length);
+	}
+}
@@ -0,0 +1,98 @@
+#ifndef _DURATION_HIST_H
+#define _DURATION_HIST_H
+
+#include <stdio.h>
+#include <sys/types.h>
+#include "ieee80211.h"
+
+/*
+ * Log-linear (HDR style) histogram.
+ * Values below 2 * HIST_SUB_COUNT are counted exactly; above, every power
+ * of two is split in HIST_SUB_COUNT linear sub-buckets, so a bucket is at
+ * most 1/HIST_SUB_COUNT (3%) of its value wide. Values of HIST_MAX_BITS
+ * bits or more are clamped to the last bucket (the true max is kept).
+ *
+ * A histogram has a single writer: recording is a couple of relaxed
+ * atomic loads and stores, no lock and no read-modify-write, so other
+ * threads may read or merge it at any time and see each counter either
+ * before or after an update. Counters are 32-bit, so these stay plain
+ * loads and stores on 32-bit targets (no libatomic).
+ */
+#define HIST_SUB_BITS  5
+#define HIST_SUB_COUNT (1 << HIST_SUB_BITS)
+#define HIST_MAX_BITS  17	/* 131071 us or bytes */
+#define HIST_BUCKETS   ((HIST_MAX_BITS - HIST_SUB_BITS + 1) * HIST_SUB_COUNT)
+
+struct hist {
+	u_int32_t total;
+	u_int32_t max;
+	u_int32_t counts[HIST_BUCKETS];
+};
+
+/* histogram keys: one per PHY and rate, or PHY and MCS for 802.11n */
+#define HIST_KEYS_11B    5	/* 1, 2, 5.5, 11 Mb/s, unknown */
+#define HIST_KEYS_OFDM   9	/* 6 to 54 Mb/s, unknown */
+#define HIST_KEYS_11N    78	/* MCS 0 to 76, unknown */
+
+#define HIST_KEY_11B     0
+#define HIST_KEY_11A     (HIST_KEY_11B + HIST_KEYS_11B)
+#define HIST_KEY_11G     (HIST_KEY_11A + HIST_KEYS_OFDM)
+#define HIST_KEY_11N     (HIST_KEY_11G + HIST_KEYS_OFDM)
+#define HIST_KEY_OTHER   (HIST_KEY_11N + HIST_KEYS_11N)
+#define HIST_KEYS        (HIST_KEY_OTHER + 1)
+
+struct phy_hists {
+	struct hist frame_duration;	/* microseconds */
+	struct hist frame_length;	/* MPDU bytes */
+	struct hist ampdu_duration;	/* microseconds, whole A-MPDU */
+	struct hist ampdu_length;	/* sum of the subframe MPDU bytes */
+};
+
+/*
+ * Duration and size histograms of every key.
+ * A frame is recorded when the next one arrives, which tells whether it
+ * ended its A-MPDU.
+ * The whole set is allocated at once; pages of keys never seen are
+ * never touched.
+ */
+struct duration_hists {
+	struct phy_hists keys[HIST_KEYS];
+
+	/* writer side, frame and PPDU not recorded yet */
+	u_int8_t has_pending;
+	u_int16_t pending_key;
+	u_int32_t pending_duration;
+	u_int32_t pending_length;
+	u_int16_t ppdu_key;
+	u_int32_t ppdu_frames;
+	u_int32_t ppdu_duration;
+	u_int32_t ppdu_length;
+};
+
+void hist_record(struct hist *h, u_int32_t value);
+
+u_int32_t hist_percentile(const struct hist *h, double percentile);
+
+void hist_merge(struct hist *dst, const struct hist *src);
+
+struct duration_hists *duration_hists_create(void);
+
+void duration_hists_destroy(struct duration_hists *dh);
+
+unsigned int duration_hists_key(const struct ieee_802_11_phdr *phdr);
+
+void duration_hists_add(struct duration_hists *dh, unsigned int key,
+						unsigned int duration, unsigned int length,
+						u_int8_t in_aggregate);
+
+void duration_hists_flush(struct duration_hists *dh);
+
+int duration_hists_save(const struct duration_hists *dh, FILE *fp);
+
+int duration_hists_load(struct duration_hists *dh, FILE *fp);
+
+void duration_hists_merge(struct duration_hists *dst, const struct duration_hists *src);
+
+void duration_hists_report(const struct duration_hists *dh, FILE *out);
+
+#endif
@@ -1,26 +1,135 @@
 #ifndef _SWAP_ENDIAN_H
 #define _SWAP_ENDIAN_H
 
-#include <pcap.h>
+#include <string.h>
+#include <sys/types.h>
 
-u_int16_t swap_endian_16(u_int16_t value);
+/*
+ * Byte order conversion helpers.
+ * The host byte order is fixed at compile time, so every conversion is
+ * either a no-op or a single byte swap instruction.
+ */
 
-u_int32_t swap_endian_32(u_int32_t value);
+#if !defined(__BYTE_ORDER__)
+#include <endian.h>
+#define __BYTE_ORDER__ __BYTE_ORDER
+#define __ORDER_LITTLE_ENDIAN__ __LITTLE_ENDIAN
+#define __ORDER_BIG_ENDIAN__ __BIG_ENDIAN
+#endif
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define HOST_LITTLE_ENDIAN 1
+#elif __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define HOST_LITTLE_ENDIAN 0
+#else
+#error "unsupported host byte order"
+#endif
+
+/**
+ * swap_endian_16 - convert 2-byte integer between endian
+ * @value: value need to be converted
+ *
+ * Return: value correspond to the new endian.
+ */
+static inline u_int16_t swap_endian_16(u_int16_t value){
+	return __builtin_bswap16(value);
+}
+
+/**
+ * swap_endian_32 - convert 4-byte integer between endian
+ * @value: value need to be converted.
+ *
+ * Return: value correspond to the new endian.
+ */
+static inline u_int32_t swap_endian_32(u_int32_t value){
+	return __builtin_bswap32(value);
+}
+
+/**
+ * swap_endian_64 - convert 8-byte integer between endian
+ * @value: value need to be converted.
+ *
+ * Return: value correspond to the new endian.
+ */
+static inline u_int64_t swap_endian_64(u_int64_t value){
+	return __builtin_bswap64(value);
+}
 
-u_int64_t swap_endian_64(u_int64_t value);
+/**
+ * is_little_endian - check if the system is little endian or big endian.
+ *
+ * Return: 1 if it is little endian, otherwise return 0.
+ */
+static inline u_int8_t is_little_endian(void){
+	return HOST_LITTLE_ENDIAN;
+}
 
-u_int8_t is_little_endian();
+/**
+ * be2local16 - convert 2-byte integer from big endian to the system's endian.
+ * @value: the value need to be converted.
+ *
+ * Return: value after converting.
+ */
+static inline u_int16_t be2local16(u_int16_t value){
+	return HOST_LITTLE_ENDIAN ? swap_endian_16(value) : value;
+}
 
-u_int16_t be2local16(u_int16_t value);
+/**
+ * le2local16 - convert 2-byte integer from little endian to the system's endian.
+ * @value: value need to be converted.
+ *
+ * Return: value after converting.
+ */
+static inline u_int16_t le2local16(u_int16_t value){
+	return HOST_LITTLE_ENDIAN ? value : swap_endian_16(value);
+}
 
-u_int16_t le2local16(u_int16_t value);
+/**
+ * be2local32 - convert 4-byte integer from big endian to the system's endian.
+ * @value: value need to be converted.
+ *
+ * Return: value after converting.
+ */
+static inline u_int32_t be2local32(u_int32_t value){
+	return HOST_LITTLE_ENDIAN ? swap_endian_32(value) : value;
+}
 
-u_int32_t be2local32(u_int32_t value);
+/**
+ * le2local32 - convert 4-byte integer from little endian to the system's endian.
+ * @value: value need to be converted.
+ *
+ * Return: value after converting.
+ */
+static inline u_int32_t le2local32(u_int32_t value){
+	return HOST_LITTLE_ENDIAN ? value : swap_endian_32(value);
+}
 
-u_int32_t le2local32(u_int32_t value);
+/**
+ * be2local64 - convert 8-byte integer from big endian to the system's endian.
+ * @value: value need to be converted.
+ *
+ * Return: value after converting.
+ */
+static inline u_int64_t be2local64(u_int64_t value){
+	return HOST_LITTLE_ENDIAN ? swap_endian_64(value) : value;
+}
 
-u_int64_t le2local64(u_int64_t value);
+/**
+ * le2local64 - convert 8-byte integer from little endian to the system's endian.
+ * @value: value need to be converted.
+ *
+ * Return: value after converting.
+ */
+static inline u_int64_t le2local64(u_int64_t value){
+	return HOST_LITTLE_ENDIAN ? value : swap_endian_64(value);
+}
 
-u_int64_t be2local64(u_int64_t value);
+/* the conversions are their own inverse */
+#define local2le16(value) le2local16(value)
+#define local2le32(value) le2local32(value)
+#define local2le64(value) le2local64(value)
+#define local2be16(value) be2local16(value)
+#define local2be32(value) be2local32(value)
+#define local2be64(value) be2local64(value)
 
 #endif
@@ -0,0 +1,297 @@
+#define _FILE_OFFSET_BITS 64
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "frame_log.h"
+#include "le_byteshift.h"
+
+#define BLOCK_HDR_LEN 16
+#define COLUMN_INT    0 /* little endian integer */
+#define COLUMN_BYTES  1 /* byte array */
+
+struct frame_log_column {
+	const char *name;
+	u_int16_t width;
+	u_int8_t kind;
+	size_t record_offset;
+};
+
+/* block order; keep in sync with the layout in frame_log.h */
+static const struct frame_log_column columns[] = {
+	{ "ts_usec",  8, COLUMN_INT,   offsetof(struct frame_log_record, ts_usec) },
+	{ "tsf",      8, COLUMN_INT,   offsetof(struct frame_log_record, tsf) },
+	{ "length",   4, COLUMN_INT,   offsetof(struct frame_log_record, length) },
+	{ "duration", 4, COLUMN_INT,   offsetof(struct frame_log_record, duration) },
+	{ "agg_id",   4, COLUMN_INT,   offsetof(struct frame_log_record, aggregate_id) },
+	{ "ta",       6, COLUMN_BYTES, offsetof(struct frame_log_record, ta) },
+	{ "ra",       6, COLUMN_BYTES, offsetof(struct frame_log_record, ra) },
+	{ "phy",      1, COLUMN_BYTES, offsetof(struct frame_log_record, phy) },
+	{ "mcs",      1, COLUMN_BYTES, offsetof(struct frame_log_record, mcs) },
+	{ "rate",     1, COLUMN_BYTES, offsetof(struct frame_log_record, rate) },
+	{ "bw",       1, COLUMN_BYTES, offsetof(struct frame_log_record, bw) },
+	{ "gi",       1, COLUMN_BYTES, offsetof(struct frame_log_record, gi) },
+	{ "flags",    1, COLUMN_BYTES, offsetof(struct frame_log_record, flags) },
+};
+
+#define N_COLUMNS (sizeof(columns) / sizeof(columns[0]))
+
+struct frame_log {
+	FILE *fp;
+	u_int8_t *block;			/* block being filled, in file layout */
+	size_t block_size;
+	u_int32_t column_offset[N_COLUMNS];
+	u_int32_t rows;				/* rows used in the current block */
+	u_int64_t block_no;			/* its place in the file */
+	u_int64_t frames;			/* frames written so far */
+	int error;					/* errno of the first write error, the
+								   log takes no more frames after it */
+};
+
+/**
+ * write_block - write the current block at its place in the file, even
+ * if partially filled. Every block but the last is full.
+ * @log: frame log.
+ *
+ * Return: 0 on success, -1 on a write error.
+ */
+static int write_block(struct frame_log *log){
+	memcpy(log->block, "ATBK", 4);
+	put_unaligned_le32(log->rows, log->block + 4);
+	put_unaligned_le64(log->block_no * FRAME_LOG_BLOCK_ROWS, log->block + 8);
+	if (fseeko(log->fp, FRAME_LOG_HEADER_LEN + (off_t)log->block_no * log->block_size,
+			   SEEK_SET) < 0 ||
+		fwrite(log->block, log->block_size, 1, log->fp) != 1){
+		log->error = errno ? errno : EIO;
+		return -1;
+	}
+	return 0;
+}
+
+/**
+ * flush_block - write the current block, and start the next one if it
+ * is full.
+ * @log: frame log.
+ *
+ * Return: 0 on success, -1 on a write error.
+ */
+static int flush_block(struct frame_log *log){
+	if (log->rows == 0)
+		return 0;
+	if (write_block(log) < 0)
+		return -1;
+	if (log->rows == FRAME_LOG_BLOCK_ROWS){
+		memset(log->block, 0, log->block_size);
+		log->rows = 0;
+		log->block_no++;
+	}
+	return 0;
+}
+
+/**
+ * frame_log_open - create a columnar frame log, or open one to continue.
+ * @path: output file.
+ * @keep: equal 1 to keep the frames of an existing log, for
+ * frame_log_rewind(); it must have the same layout.
+ *
+ * Return: the log, NULL on error (errno is set).
+ */
+struct frame_log *frame_log_open(const char *path, u_int8_t keep){
+	u_int8_t header[FRAME_LOG_HEADER_LEN];
+	u_int8_t found[FRAME_LOG_HEADER_LEN];
+	struct frame_log *log;
+	size_t offset = BLOCK_HDR_LEN;
+	size_t len = 0;
+	unsigned int i;
+	int err;
+
+	log = calloc(1, sizeof(*log));
+	if (log == NULL)
+		return NULL;
+
+	memset(header, 0, sizeof(header));
+	memcpy(header, "ATFL", 4);
+	put_unaligned_le16(FRAME_LOG_VERSION, header + 4);
+	put_unaligned_le16(N_COLUMNS, header + 6);
+	put_unaligned_le32(FRAME_LOG_BLOCK_ROWS, header + 8);
+
+	for (i = 0; i < N_COLUMNS; i++){
+		u_int8_t *dir = header + 16 + 16 * i;
+
+		log->column_offset[i] = offset;
+		strncpy((char*)dir, columns[i].name, 10);
+		put_unaligned_le16(columns[i].width, dir + 10);
+		put_unaligned_le32(offset, dir + 12);
+		offset += ((size_t)columns[i].width * FRAME_LOG_BLOCK_ROWS + 7) & ~(size_t)7;
+	}
+	log->block_size = offset;
+	put_unaligned_le32(log->block_size, header + 12);
+
+	log->block = calloc(1, log->block_size);
+	if (log->block == NULL)
+		goto fail;
+	if (keep){
+		log->fp = fopen(path, "r+b");
+		if (log->fp == NULL && errno != ENOENT)
+			goto fail;
+	}
+	if (log->fp != NULL)
+		len = fread(found, 1, sizeof(found), log->fp);
+	if (len != 0){
+		if (len != sizeof(found) || memcmp(found, header, sizeof(header)) != 0){
+			errno = EINVAL;
+			goto fail;
+		}
+		return log;
+	}
+
+	/* new, or empty */
+	if (log->fp == NULL)
+		log->fp = fopen(path, "wb");
+	if (log->fp == NULL || fseeko(log->fp, 0, SEEK_SET) < 0 ||
+		fwrite(header, sizeof(header), 1, log->fp) != 1)
+		goto fail;
+	return log;
+
+fail:
+	err = errno;
+	if (log->fp)
+		fclose(log->fp);
+	free(log->block);
+	free(log);
+	errno = err;
+	return NULL;
+}
+
+/**
+ * frame_log_rewind - drop the frames past the first @frames, the next
+ * frame appended is frame @frames. Frames logged after a checkpoint are
+ * analyzed again when it is resumed.
+ * @log: frame log, opened to keep its frames.
+ * @frames: frames to keep, as given by frame_log_sync().
+ *
+ * Return: 0 on success, -1 if the log holds fewer frames or on an I/O
+ * error (errno is set).
+ */
+int frame_log_rewind(struct frame_log *log, u_int64_t frames){
+	u_int64_t block_no = frames / FRAME_LOG_BLOCK_ROWS;
+	u_int32_t rows = frames % FRAME_LOG_BLOCK_ROWS;
+	off_t end = FRAME_LOG_HEADER_LEN + (off_t)block_no * log->block_size;
+	unsigned int i;
+
+	memset(log->block, 0, log->block_size);
+	if (rows){
+		/* the partial block is filled on from the rows kept */
+		if (fseeko(log->fp, end, SEEK_SET) < 0)
+			return -1;
+		if (fread(log->block, log->block_size, 1, log->fp) != 1 ||
+			memcmp(log->block, "ATBK", 4) != 0 ||
+			get_unaligned_le32(log->block + 4) < rows ||
+			get_unaligned_le64(log->block + 8) != block_no * FRAME_LOG_BLOCK_ROWS){
+			errno = EINVAL;
+			return -1;
+		}
+		for (i = 0; i < N_COLUMNS; i++)
+			memset(log->block + log->column_offset[i] + (size_t)rows * columns[i].width, 0,
+				   (size_t)(FRAME_LOG_BLOCK_ROWS - rows) * columns[i].width);
+		end += log->block_size;
+	}
+	else if (fseeko(log->fp, 0, SEEK_END) < 0 || ftello(log->fp) < end){
+		errno = EINVAL;
+		return -1;
+	}
+	if (fflush(log->fp) != 0 || ftruncate(fileno(log->fp), end) < 0)
+		return -1;
+
+	log->block_no = block_no;
+	log->rows = rows;
+	log->frames = frames;
+	return 0;
+}
+
+/**
+ * frame_log_sync - write the frames so far to disk, for a checkpoint.
+ * The partial block is written in place and filled on.
+ * @log: frame log.
+ * @frames: receives the number of frames written.
+ *
+ * Return: 0 on success, -1 on a write error, now or before.
+ */
+int frame_log_sync(struct frame_log *log, u_int64_t *frames){
+	if (log->error)
+		return -1;
+	if (log->rows != 0 && write_block(log) < 0)
+		return -1;
+	if (fflush(log->fp) != 0 || fsync(fileno(log->fp)) < 0){
+		log->error = errno ? errno : EIO;
+		return -1;
+	}
+	*frames = log->frames;
+	return 0;
+}
+
+/**
+ * frame_log_append - add one frame.
+ * The block is written when the next frame does not fit in it any more.
+ * After a write error the frame is dropped, see frame_log_error().
+ * @log: frame log.
+ * @rec: frame record.
+ *
+ * Return: 0 on success, -1 on a write error, now or before.
+ */
+int frame_log_append(struct frame_log *log, const struct frame_log_record *rec){
+	unsigned int i;
+
+	if (log->error)
+		return -1;
+	if (log->rows == FRAME_LOG_BLOCK_ROWS && flush_block(log) < 0)
+		return -1;
+
+	for (i = 0; i < N_COLUMNS; i++){
+		const u_int8_t *src = (const u_int8_t*)rec + columns[i].record_offset;
+		u_int8_t *dst = log->block + log->column_offset[i] +
+						(size_t)log->rows * columns[i].width;
+
+		if (columns[i].kind == COLUMN_BYTES)
+			memcpy(dst, src, columns[i].width);
+		else if (columns[i].width == 8)
+			put_unaligned_le64(*(const u_int64_t*)src, dst);
+		else
+			put_unaligned_le32(*(const u_int32_t*)src, dst);
+	}
+
+	log->rows++;
+	log->frames++;
+	return 0;
+}
+
+/**
+ * frame_log_error - first write error of the log.
+ * @log: frame log.
+ *
+ * Return: its errno, 0 if every block was written so far.
+ */
+int frame_log_error(const struct frame_log *log){
+	return log->error;
+}
+
+/**
+ * frame_log_close - write the last block and close the log.
+ * @log: frame log.
+ *
+ * Return: 0 on success, -1 on a write error, now or before (errno is set).
+ */
+int frame_log_close(struct frame_log *log){
+	int ret = log->error ? -1 : flush_block(log);
+	int error = log->error;
+
+	if (fclose(log->fp) != 0)
+		ret = -1;
+	if (error)
+		errno = error;
+	free(log->block);
+	free(log);
+	return ret;
+}
@@ -0,0 +1,88 @@
+#ifndef _FRAME_LOG_H
+#define _FRAME_LOG_H
+
+#include <stdio.h>
+#include <sys/types.h>
+
+/*
+ * Columnar per-frame log.
+ *
+ * File layout (all integers little endian):
+ *
+ *   file header, FRAME_LOG_HEADER_LEN (256) bytes
+ *     0   char[4]  magic "ATFL"
+ *     4   u16      version (1)
+ *     6   u16      number of columns
+ *     8   u32      rows per block (FRAME_LOG_BLOCK_ROWS)
+ *     12  u32      block size in bytes
+ *     16  column directory, 16 bytes per column:
+ *           char[10] name (NUL padded), u16 element width,
+ *           u32 byte offset of the column inside a block
+ *
+ *   blocks, each exactly "block size" bytes, block k at
+ *   FRAME_LOG_HEADER_LEN + k * block size
+ *     0   char[4]  magic "ATBK"
+ *     4   u32      rows used in this block
+ *     8   u64      index of the first frame of the block
+ *     16  columns, each rows-per-block elements wide and 8 byte
+ *         aligned; rows past "rows used" are zero
+ *
+ * Columns, in block order:
+ *   ts_usec   u64  pcap timestamp, microseconds since the epoch
+ *   tsf       u64  radiotap TSF, valid if FRAME_LOG_F_TSF
+ *   length    u32  MPDU length in bytes, including FCS
+ *   duration  u32  airtime charged to the frame, microseconds
+ *   agg_id    u32  radiotap A-MPDU reference, valid if FRAME_LOG_F_AGG_ID
+ *   ta        u8[6] transmitter address, valid if FRAME_LOG_F_TA
+ *   ra        u8[6] receiver address, valid if FRAME_LOG_F_RA
+ *   phy       u8   PHDR_802_11_PHY_*
+ *   mcs       u8   HT MCS index, 0xff if none
+ *   rate      u8   legacy rate in .5 Mb/s units, 0 if none
+ *   bw        u8   radiotap MCS bandwidth, 0xff if unknown
+ *   gi        u8   1 short guard interval, 0 long, 0xff if unknown
+ *   flags     u8   FRAME_LOG_F_*
+ */
+
+#define FRAME_LOG_HEADER_LEN 256
+#define FRAME_LOG_BLOCK_ROWS 1024
+#define FRAME_LOG_VERSION    1
+
+#define FRAME_LOG_F_TSF       0x01 /* tsf is valid */
+#define FRAME_LOG_F_AGGREGATE 0x02 /* frame is an A-MPDU subframe */
+#define FRAME_LOG_F_AGG_ID    0x04 /* agg_id is valid */
+#define FRAME_LOG_F_TA        0x08 /* ta is valid */
+#define FRAME_LOG_F_RA        0x10 /* ra is valid */
+#define FRAME_LOG_F_RETRY     0x20 /* frame is a retransmission */
+#define FRAME_LOG_F_BAD_FCS   0x40 /* frame failed CRC, ta and ra not logged */
+
+struct frame_log_record {
+	u_int64_t ts_usec;
+	u_int64_t tsf;
+	u_int32_t length;
+	u_int32_t duration;
+	u_int32_t aggregate_id;
+	u_int8_t ta[6];
+	u_int8_t ra[6];
+	u_int8_t phy;
+	u_int8_t mcs;
+	u_int8_t rate;
+	u_int8_t bw;
+	u_int8_t gi;
+	u_int8_t flags;
+};
+
+struct frame_log;
+
+struct frame_log *frame_log_open(const char *path, u_int8_t keep);
+
+int frame_log_rewind(struct frame_log *log, u_int64_t frames);
+
+int frame_log_sync(struct frame_log *log, u_int64_t *frames);
+
+int frame_log_append(struct frame_log *log, const struct frame_log_record *rec);
+
+int frame_log_error(const struct frame_log *log);
+
+int frame_log_close(struct frame_log *log);
+
+#endif
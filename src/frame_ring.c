@@ -0,0 +1,203 @@
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include "frame_ring.h"
+
+#define load_acquire(p)     __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define store_release(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+/**
+ * frame_ring_init - allocate the slots and their slabs.
+ * @r: ring.
+ * @slots: number of slots, rounded up to a power of two.
+ * @slab_size: bytes kept per frame, the capture snapshot length.
+ *
+ * Return: 0 on success, -1 if out of memory or descriptors (errno is
+ * set).
+ */
+int frame_ring_init(struct frame_ring *r, unsigned int slots, unsigned int slab_size){
+	unsigned int size = 1, i;
+
+	while (size < slots)
+		size <<= 1;
+
+	memset(r, 0, sizeof(*r));
+	r->size = size;
+	r->mask = size - 1;
+	r->slab_size = slab_size;
+	r->frames = calloc(size, sizeof(*r->frames));
+	r->slabs = malloc((size_t)size * slab_size);
+	r->wake_fd = eventfd(0, EFD_CLOEXEC);
+	if (r->frames == NULL || r->slabs == NULL || r->wake_fd < 0){
+		frame_ring_destroy(r);
+		return -1;
+	}
+	for (i = 0; i < size; i++)
+		r->frames[i].data = r->slabs + (size_t)i * slab_size;
+	return 0;
+}
+
+/**
+ * frame_ring_destroy - free the slots, both threads must be done.
+ * @r: ring.
+ */
+void frame_ring_destroy(struct frame_ring *r){
+	free(r->frames);
+	free(r->slabs);
+	if (r->wake_fd >= 0)
+		close(r->wake_fd);
+	r->frames = NULL;
+	r->slabs = NULL;
+	r->wake_fd = -1;
+}
+
+/**
+ * wake - wake the consumer up if it is going to sleep.
+ * The full fences here and in frame_ring_wait() order each side's store
+ * before its load of the other's: either the consumer sees the new head
+ * and does not sleep, or the producer sees it sleeping and signals.
+ * @r: ring.
+ */
+static void wake(struct frame_ring *r){
+	u_int64_t one = 1;
+
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (!__atomic_load_n(&r->sleeping, __ATOMIC_RELAXED))
+		return;
+	/* fails only on a full counter, which wakes the consumer as well */
+	if (write(r->wake_fd, &one, sizeof(one)) < 0)
+		return;
+}
+
+/**
+ * frame_ring_publish - make the filled slots visible to the consumer.
+ * @r: ring.
+ */
+void frame_ring_publish(struct frame_ring *r){
+	if (r->head != r->prod_head){
+		store_release(&r->head, r->prod_head);
+		wake(r);
+	}
+}
+
+/**
+ * frame_ring_enqueue - pcap_handler of the capture thread: copy a frame
+ * into the next slot, or count it as an overflow if the ring is full.
+ * @ring: the frame_ring.
+ * @header: pointer to pcap packet header.
+ * @packet: captured bytes.
+ */
+void frame_ring_enqueue(u_char *ring, const struct pcap_pkthdr *header, const u_char *packet){
+	struct frame_ring *r = (struct frame_ring*)ring;
+	struct ring_frame *f;
+
+	if (r->prod_head - r->prod_tail == r->size){
+		r->prod_tail = load_acquire(&r->tail);
+		if (r->prod_head - r->prod_tail == r->size){
+			__atomic_store_n(&r->overflows, r->overflows + 1, __ATOMIC_RELAXED);
+			return;
+		}
+	}
+
+	f = &r->frames[r->prod_head & r->mask];
+	f->hdr = *header;
+	if (f->hdr.caplen > r->slab_size)
+		f->hdr.caplen = r->slab_size;
+	memcpy(f->data, packet, f->hdr.caplen);
+	r->prod_head++;
+
+	if (r->prod_head - r->head >= RING_BATCH)
+		frame_ring_publish(r);
+}
+
+/**
+ * frame_ring_close - publish the last frames and tell the consumer
+ * there will be no more.
+ * @r: ring.
+ */
+void frame_ring_close(struct frame_ring *r){
+	frame_ring_publish(r);
+	store_release(&r->closed, 1);
+	wake(r);
+}
+
+/**
+ * frame_ring_closed - check whether the producer is done. Frames
+ * published before the close are visible once this returns 1.
+ * @r: ring.
+ *
+ * Return: 1 if closed.
+ */
+int frame_ring_closed(const struct frame_ring *r){
+	return load_acquire(&r->closed);
+}
+
+/**
+ * frame_ring_wait - sleep until frames are published or the ring is
+ * closed, from the consumer thread once frame_ring_consume() found
+ * nothing. It may return early.
+ * @r: ring.
+ * @timeout_ms: longest sleep, -1 for none.
+ */
+void frame_ring_wait(struct frame_ring *r, int timeout_ms){
+	struct pollfd pfd = {.fd = r->wake_fd, .events = POLLIN};
+	u_int64_t count;
+
+	__atomic_store_n(&r->sleeping, 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&r->head, __ATOMIC_RELAXED) == r->tail &&
+		!__atomic_load_n(&r->closed, __ATOMIC_RELAXED) &&
+		poll(&pfd, 1, timeout_ms) > 0){
+		/* clear the counter; if that fails the next wait returns early */
+		if (read(r->wake_fd, &count, sizeof(count)) < 0)
+			count = 0;
+	}
+	__atomic_store_n(&r->sleeping, 0, __ATOMIC_RELAXED);
+}
+
+/**
+ * frame_ring_consume - analyze the published frames.
+ * @r: ring.
+ * @handler: called on each frame, in order.
+ * @user: first argument of @handler.
+ *
+ * Return: number of frames handed to @handler, 0 if the ring was empty.
+ */
+unsigned int frame_ring_consume(struct frame_ring *r, pcap_handler handler, u_char *user){
+	u_int32_t head = load_acquire(&r->head);
+	u_int32_t tail = r->tail;
+	unsigned int n = 0;
+
+	if (head - tail > r->max_occupancy)
+		r->max_occupancy = head - tail;
+
+	while (tail != head){
+		struct ring_frame *f = &r->frames[tail & r->mask];
+
+		handler(user, &f->hdr, f->data);
+		tail++;
+		if (++n % RING_BATCH == 0)
+			store_release(&r->tail, tail);
+	}
+	if (r->tail != tail)
+		store_release(&r->tail, tail);
+	return n;
+}
+
+/**
+ * frame_ring_occupancy - sample the fill level, from the consumer thread.
+ * @r: ring.
+ * @max_occupancy: highest fill level seen by the consumer since the
+ * last call.
+ *
+ * Return: slots in use.
+ */
+u_int32_t frame_ring_occupancy(struct frame_ring *r, u_int32_t *max_occupancy){
+	u_int32_t used = load_acquire(&r->head) - r->tail;
+
+	*max_occupancy = r->max_occupancy > used ? r->max_occupancy : used;
+	r->max_occupancy = 0;
+	return used;
+}
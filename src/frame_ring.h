@@ -0,0 +1,78 @@
+#ifndef _FRAME_RING_H
+#define _FRAME_RING_H
+
+#include <pcap.h>
+#include <sys/types.h>
+
+#define RING_CACHE_LINE 64
+#define RING_BATCH      32		/* frames published or released at once */
+#define RING_DEFAULT_SLOTS 1024
+
+struct ring_frame {
+	struct pcap_pkthdr hdr;
+	u_char *data;				/* the slot's slab */
+};
+
+/*
+ * Single-producer/single-consumer ring of captured frames.
+ * The capture thread copies each frame into the preallocated slab of
+ * the next slot and publishes the slots RING_BATCH at a time (and
+ * whenever libpcap hands its buffer back); the analysis thread releases
+ * them the same way. Each side owns one cache line of indices and only
+ * reads the other's with acquire loads, so there is no lock and no
+ * read-modify-write. A frame that finds the ring full is dropped and
+ * counted, the capture thread never waits for the analysis. An idle
+ * consumer sleeps on an eventfd, which the producer only signals when
+ * it publishes to a consumer that said it was going to sleep.
+ */
+struct frame_ring {
+	/* producer */
+	u_int32_t head __attribute__((aligned(RING_CACHE_LINE)));	/* published */
+	u_int32_t prod_head;		/* next slot to fill */
+	u_int32_t prod_tail;		/* consumer index last seen */
+	u_int32_t overflows;		/* frames dropped on a full ring */
+	u_int8_t closed;			/* no more frames */
+
+	/* consumer */
+	u_int32_t tail __attribute__((aligned(RING_CACHE_LINE)));	/* released */
+	u_int32_t max_occupancy;	/* since the last frame_ring_occupancy() */
+	u_int8_t sleeping;			/* waits on wake_fd, read by the producer */
+
+	/* set up once */
+	unsigned int size __attribute__((aligned(RING_CACHE_LINE)));
+	unsigned int mask;
+	unsigned int slab_size;
+	struct ring_frame *frames;
+	u_char *slabs;
+	int wake_fd;				/* eventfd */
+};
+
+int frame_ring_init(struct frame_ring *r, unsigned int slots, unsigned int slab_size);
+
+void frame_ring_destroy(struct frame_ring *r);
+
+void frame_ring_enqueue(u_char *ring, const struct pcap_pkthdr *header, const u_char *packet);
+
+void frame_ring_publish(struct frame_ring *r);
+
+void frame_ring_close(struct frame_ring *r);
+
+unsigned int frame_ring_consume(struct frame_ring *r, pcap_handler handler, u_char *user);
+
+int frame_ring_closed(const struct frame_ring *r);
+
+void frame_ring_wait(struct frame_ring *r, int timeout_ms);
+
+u_int32_t frame_ring_occupancy(struct frame_ring *r, u_int32_t *max_occupancy);
+
+/**
+ * frame_ring_overflows - frames dropped so far on a full ring.
+ * @r: ring.
+ *
+ * Return: the count, it wraps.
+ */
+static inline u_int32_t frame_ring_overflows(const struct frame_ring *r){
+	return __atomic_load_n(&r->overflows, __ATOMIC_RELAXED);
+}
+
+#endif
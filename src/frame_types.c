@@ -0,0 +1,181 @@
+#include <string.h>
+#include "frame_types.h"
+#include "mac_header.h"
+
+#define MGMT(stype) ((IEEE80211_FTYPE_MGMT << 4) | (stype))
+#define CTL(stype)  ((IEEE80211_FTYPE_CTL << 4) | (stype))
+#define DATA(stype) ((IEEE80211_FTYPE_DATA << 4) | (stype))
+#define EXT(stype)  ((3 << 4) | (stype))
+
+/* IEEE 802.11-2016 table 9-1, indexed by FRAME_TYPE_INDEX() */
+const struct frame_type_info frame_type_table[FRAME_TYPES] = {
+	[MGMT(0)]  = { "mgmt assoc request" },
+	[MGMT(1)]  = { "mgmt assoc response" },
+	[MGMT(2)]  = { "mgmt reassoc request" },
+	[MGMT(3)]  = { "mgmt reassoc response" },
+	[MGMT(IEEE80211_STYPE_PROBE_REQ)]  = { "mgmt probe request", FT_OVERHEAD_PROBE },
+	[MGMT(IEEE80211_STYPE_PROBE_RESP)] = { "mgmt probe response", FT_OVERHEAD_PROBE },
+	[MGMT(6)]  = { "mgmt timing advertisement" },
+	[MGMT(7)]  = { "mgmt reserved 7" },
+	[MGMT(IEEE80211_STYPE_BEACON)]     = { "mgmt beacon", FT_OVERHEAD_BEACON },
+	[MGMT(9)]  = { "mgmt ATIM" },
+	[MGMT(10)] = { "mgmt disassoc" },
+	[MGMT(11)] = { "mgmt auth" },
+	[MGMT(12)] = { "mgmt deauth" },
+	[MGMT(13)] = { "mgmt action" },
+	[MGMT(14)] = { "mgmt action no ack" },
+	[MGMT(15)] = { "mgmt reserved 15" },
+
+	[CTL(0)]   = { "ctl reserved 0" },
+	[CTL(1)]   = { "ctl reserved 1" },
+	[CTL(2)]   = { "ctl trigger" },
+	[CTL(3)]   = { "ctl TACK" },
+	[CTL(4)]   = { "ctl beamforming report poll" },
+	[CTL(5)]   = { "ctl VHT NDP announcement" },
+	[CTL(6)]   = { "ctl frame extension" },
+	[CTL(7)]   = { "ctl wrapper" },
+	[CTL(8)]   = { "ctl block ack request" },
+	[CTL(9)]   = { "ctl block ack" },
+	[CTL(10)]  = { "ctl PS-Poll" },
+	[CTL(11)]  = { "ctl RTS" },
+	[CTL(IEEE80211_STYPE_CTS)] = { "ctl CTS" },
+	[CTL(IEEE80211_STYPE_ACK)] = { "ctl ACK" },
+	[CTL(14)]  = { "ctl CF-End" },
+	[CTL(15)]  = { "ctl CF-End+CF-Ack" },
+
+	[DATA(0)]  = { "data" },
+	[DATA(1)]  = { "data+CF-Ack" },
+	[DATA(2)]  = { "data+CF-Poll" },
+	[DATA(3)]  = { "data+CF-Ack+CF-Poll" },
+	[DATA(4)]  = { "data null" },
+	[DATA(5)]  = { "data CF-Ack" },
+	[DATA(6)]  = { "data CF-Poll" },
+	[DATA(7)]  = { "data CF-Ack+CF-Poll" },
+	[DATA(8)]  = { "data QoS" },
+	[DATA(9)]  = { "data QoS+CF-Ack" },
+	[DATA(10)] = { "data QoS+CF-Poll" },
+	[DATA(11)] = { "data QoS+CF-Ack+CF-Poll" },
+	[DATA(12)] = { "data QoS null" },
+	[DATA(13)] = { "data reserved 13" },
+	[DATA(14)] = { "data QoS CF-Poll" },
+	[DATA(15)] = { "data QoS CF-Ack+CF-Poll" },
+
+	[EXT(0)]   = { "ext DMG beacon", FT_OVERHEAD_BEACON },
+	[EXT(1)]   = { "ext S1G beacon", FT_OVERHEAD_BEACON },
+	[EXT(2)]   = { "ext reserved 2" },
+	[EXT(3)]   = { "ext reserved 3" },
+	[EXT(4)]   = { "ext reserved 4" },
+	[EXT(5)]   = { "ext reserved 5" },
+	[EXT(6)]   = { "ext reserved 6" },
+	[EXT(7)]   = { "ext reserved 7" },
+	[EXT(8)]   = { "ext reserved 8" },
+	[EXT(9)]   = { "ext reserved 9" },
+	[EXT(10)]  = { "ext reserved 10" },
+	[EXT(11)]  = { "ext reserved 11" },
+	[EXT(12)]  = { "ext reserved 12" },
+	[EXT(13)]  = { "ext reserved 13" },
+	[EXT(14)]  = { "ext reserved 14" },
+	[EXT(15)]  = { "ext reserved 15" },
+};
+
+static const char *type_names[4] = { "management", "control", "data", "extension" };
+
+/**
+ * frame_types_init - clear the counters.
+ * @ft: frame type stats.
+ */
+void frame_types_init(struct frame_type_stats *ft){
+	memset(ft, 0, sizeof(*ft));
+}
+
+/**
+ * frame_types_reset - start a new interval.
+ * @ft: frame type stats.
+ */
+void frame_types_reset(struct frame_type_stats *ft){
+	frame_types_init(ft);
+}
+
+static struct airtime_counter *counter(struct frame_type_stats *ft, int index){
+	return index == FRAME_TYPE_UNKNOWN ? &ft->unknown : &ft->types[index];
+}
+
+/**
+ * frame_types_account - charge a frame to its type and subtype.
+ * @ft: frame type stats.
+ * @index: FRAME_TYPE_INDEX() of the frame, or FRAME_TYPE_UNKNOWN.
+ * @duration: airtime of the frame.
+ */
+void frame_types_account(struct frame_type_stats *ft, int index, int duration){
+	struct airtime_counter *c;
+
+	c = counter(ft, index);
+	c->airtime += duration;
+	c->frames++;
+}
+
+/**
+ * frame_types_adjust - change the airtime of a frame already accounted.
+ * @ft: frame type stats.
+ * @index: FRAME_TYPE_INDEX() the frame was accounted with.
+ * @adjust: airtime to add.
+ */
+void frame_types_adjust(struct frame_type_stats *ft, int index, int adjust){
+	counter(ft, index)->airtime += adjust;
+}
+
+static double percent(u_int64_t part, u_int64_t total){
+	return total ? 100.0 * part / total : 0.0;
+}
+
+/**
+ * frame_types_report - print the airtime of every frame type seen, the
+ * share of each type and the beacon and probe overhead.
+ * @ft: frame type stats.
+ * @out: report stream.
+ */
+void frame_types_report(const struct frame_type_stats *ft, FILE *out){
+	u_int64_t by_type[4] = { 0 };
+	u_int64_t beacon = 0, probe = 0, total = ft->unknown.airtime;
+	u_int32_t beacons = 0, probes = 0;
+	unsigned int i;
+
+	for (i = 0; i < FRAME_TYPES; i++){
+		const struct airtime_counter *c = &ft->types[i];
+
+		by_type[i >> 4] += c->airtime;
+		total += c->airtime;
+		if (frame_type_table[i].overhead == FT_OVERHEAD_BEACON){
+			beacon += c->airtime;
+			beacons += c->frames;
+		}
+		else if (frame_type_table[i].overhead == FT_OVERHEAD_PROBE){
+			probe += c->airtime;
+			probes += c->frames;
+		}
+	}
+
+	for (i = 0; i < FRAME_TYPES; i++){
+		const struct airtime_counter *c = &ft->types[i];
+		if (c->frames == 0)
+			continue;
+		fprintf(out, "  %s: airtime %llu us (%.1f%%), %u frames\n",
+				frame_type_table[i].name, (unsigned long long)c->airtime,
+				percent(c->airtime, total), c->frames);
+	}
+	if (ft->unknown.frames)
+		fprintf(out, "  type unknown: airtime %llu us (%.1f%%), %u frames\n",
+				(unsigned long long)ft->unknown.airtime,
+				percent(ft->unknown.airtime, total), ft->unknown.frames);
+
+	for (i = 0; i < 4; i++){
+		if (by_type[i] == 0)
+			continue;
+		fprintf(out, "  %s: %.1f%% of the airtime\n", type_names[i],
+				percent(by_type[i], total));
+	}
+	fprintf(out, "  beacon overhead: airtime %llu us (%.1f%%), %u frames\n",
+			(unsigned long long)beacon, percent(beacon, total), beacons);
+	fprintf(out, "  probe overhead: airtime %llu us (%.1f%%), %u frames\n",
+			(unsigned long long)probe, percent(probe, total), probes);
+}
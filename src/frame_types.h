@@ -0,0 +1,45 @@
+#ifndef _FRAME_TYPES_H
+#define _FRAME_TYPES_H
+
+#include <stdio.h>
+#include <sys/types.h>
+#include "channel_stats.h"
+
+/* index of a frame type: type << 4 | subtype, from Frame Control */
+#define FRAME_TYPES 64
+#define FRAME_TYPE_INDEX(fc) ((((fc) & 0x000c) << 2) | (((fc) & 0x00f0) >> 4))
+#define FRAME_TYPE_UNKNOWN -1	/* MAC header not captured */
+
+#define IEEE80211_STYPE_PROBE_REQ  4
+#define IEEE80211_STYPE_PROBE_RESP 5
+#define IEEE80211_STYPE_BEACON     8
+
+/* what a frame type is charged as, besides its own counter */
+#define FT_OVERHEAD_NONE   0
+#define FT_OVERHEAD_BEACON 1
+#define FT_OVERHEAD_PROBE  2
+
+struct frame_type_info {
+	const char *name;
+	u_int8_t overhead;		/* FT_OVERHEAD_* */
+};
+
+extern const struct frame_type_info frame_type_table[FRAME_TYPES];
+
+/* Airtime per frame type and subtype over one interval */
+struct frame_type_stats {
+	struct airtime_counter types[FRAME_TYPES];
+	struct airtime_counter unknown;
+};
+
+void frame_types_init(struct frame_type_stats *ft);
+
+void frame_types_reset(struct frame_type_stats *ft);
+
+void frame_types_account(struct frame_type_stats *ft, int index, int duration);
+
+void frame_types_adjust(struct frame_type_stats *ft, int index, int adjust);
+
+void frame_types_report(const struct frame_type_stats *ft, FILE *out);
+
+#endif
@@ -1,7 +1,7 @@
 #ifndef _IEEE_802_11_H
 #define _IEEE_802_11_H 
 
-#include <pcap.h> 
+#include <sys/types.h>
 
 
 /*
@@ -35,7 +35,11 @@
 #ifndef IEEE80211RADIOTAP_H
 #define IEEE80211RADIOTAP_H
 
-#include <pcap.h>
+#include <sys/types.h>
+
+#ifndef __packed
+#define __packed __attribute__((packed))
+#endif
 
 /* Base version of the radiotap packet header data */
 #define PKTHDR_RADIOTAP_VERSION		0
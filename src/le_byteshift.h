@@ -3,39 +3,53 @@
 #define _TOOLS_LE_BYTESHIFT_H
 
 #include <stdint.h>
+#include <string.h>
+#include "endian_converter.h"
+
+/*
+ * Unaligned little endian accessors.
+ * memcpy() of a fixed size compiles to a single (unaligned) load or
+ * store where the target allows it and to byte accesses elsewhere;
+ * the byte order is then fixed by endian_converter.h.
+ */
 
 static inline uint16_t __get_unaligned_le16(const uint8_t *p)
 {
-	return p[0] | p[1] << 8;
+	uint16_t v;
+	memcpy(&v, p, sizeof(v));
+	return le2local16(v);
 }
 
 static inline uint32_t __get_unaligned_le32(const uint8_t *p)
 {
-	return p[0] | p[1] << 8 | p[2] << 16 | p[3] << 24;
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return le2local32(v);
 }
 
 static inline uint64_t __get_unaligned_le64(const uint8_t *p)
 {
-	return (uint64_t)__get_unaligned_le32(p + 4) << 32 |
-	       __get_unaligned_le32(p);
+	uint64_t v;
+	memcpy(&v, p, sizeof(v));
+	return le2local64(v);
 }
 
 static inline void __put_unaligned_le16(uint16_t val, uint8_t *p)
 {
-	*p++ = val;
-	*p++ = val >> 8;
+	val = local2le16(val);
+	memcpy(p, &val, sizeof(val));
 }
 
 static inline void __put_unaligned_le32(uint32_t val, uint8_t *p)
 {
-	__put_unaligned_le16(val >> 16, p + 2);
-	__put_unaligned_le16(val, p);
+	val = local2le32(val);
+	memcpy(p, &val, sizeof(val));
 }
 
 static inline void __put_unaligned_le64(uint64_t val, uint8_t *p)
 {
-	__put_unaligned_le32(val >> 32, p + 4);
-	__put_unaligned_le32(val, p);
+	val = local2le64(val);
+	memcpy(p, &val, sizeof(val));
 }
 
 static inline uint16_t get_unaligned_le16(const void *p)
@@ -0,0 +1,92 @@
+#include <stdlib.h>
+#include <string.h>
+#include "libairtime.h"
+#include "packet_analyzer.h"
+
+/* an engine is one analyzer with no file outputs attached */
+struct airtime {
+	struct arguments args;
+};
+
+/**
+ * airtime_create - set up an engine.
+ * @cfg: settings, NULL for one silent interval over the whole stream.
+ *
+ * Return: the engine, NULL if out of memory.
+ */
+struct airtime *airtime_create(const struct airtime_config *cfg){
+	struct airtime *at = calloc(1, sizeof(*at));
+
+	if (at == NULL)
+		return NULL;
+	if (cfg != NULL){
+		at->args.interval = cfg->interval;
+		at->args.arena_cap = cfg->arena_cap;
+		at->args.report = cfg->report;
+		at->args.driver = cfg->driver;
+	}
+	analyzer_init(&at->args);
+	return at;
+}
+
+/**
+ * airtime_feed - cost one frame.
+ * @at: engine.
+ * @frame: the frame, radiotap header included.
+ *
+ * Return: 1 if the frame was costed, 0 if it was left out (malformed
+ * radiotap header).
+ */
+int airtime_feed(struct airtime *at, const struct airtime_frame *frame){
+	return analyzer_feed(&at->args, frame);
+}
+
+/**
+ * airtime_feed_batch - cost frames in order.
+ * @at: engine.
+ * @frames: the frames.
+ * @count: number of frames.
+ *
+ * Return: number of frames costed.
+ */
+unsigned int airtime_feed_batch(struct airtime *at, const struct airtime_frame *frames,
+								unsigned int count){
+	unsigned int i, costed = 0;
+
+	for (i = 0; i < count; i++)
+		costed += analyzer_feed(&at->args, &frames[i]);
+	return costed;
+}
+
+/**
+ * airtime_snapshot - read the counters, the engine carries on.
+ * @at: engine.
+ * @snap: receives the counters.
+ */
+void airtime_snapshot(struct airtime *at, struct airtime_snapshot *snap){
+	const struct arguments *args = &at->args;
+
+	memset(snap, 0, sizeof(*snap));
+	snap->frames = args->state.pkt_no;
+	snap->airtime = args->airtime;
+	snap->corrupted_airtime = args->corrupted_airtime;
+	snap->inferred_airtime = args->responses.total_inferred_airtime;
+	snap->inferred_responses = args->responses.total_inferred;
+	tsf_util_totals(&args->util, &snap->tsf_busy, &snap->tsf_span);
+	snap->driver = args->state.driver.profile;
+	snap->interval_no = args->interval_no;
+	snap->interval_start = args->interval_start;
+	snap->interval_airtime = args->interval_airtime;
+}
+
+/**
+ * airtime_destroy - report the last interval and free the engine.
+ * @at: engine, may be NULL.
+ */
+void airtime_destroy(struct airtime *at){
+	if (at == NULL)
+		return;
+	analyzer_finish(&at->args);
+	analyzer_release(&at->args);
+	free(at);
+}
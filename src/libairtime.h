@@ -0,0 +1,73 @@
+#ifndef _LIBAIRTIME_H
+#define _LIBAIRTIME_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <sys/types.h>
+
+/*
+ * libairtime - streaming airtime engine.
+ *
+ * The radiotap parser, PHY classifier, A-MPDU detection and duration
+ * engine of airtime_cal, without libpcap: the caller hands over frames
+ * it already holds (radiotap header followed by the 802.11 frame) and
+ * reads the counters back at any time. Frames must be fed in capture
+ * order; an engine is not thread safe, use one per thread.
+ *
+ * Build with "make libairtime.a" or "make libairtime.so" in src/.
+ */
+
+#define AIRTIME_API __attribute__((visibility("default")))
+
+struct airtime;
+
+/* one captured frame */
+struct airtime_frame {
+	u_int64_t ts_usec;			/* capture timestamp (us), cuts the intervals */
+	const u_int8_t *data;		/* radiotap header, then the 802.11 frame */
+	u_int32_t caplen;			/* bytes at data */
+	u_int32_t len;				/* length on air, radiotap header included */
+};
+
+/* A-MPDU timestamp convention of the capturing driver */
+#define AIRTIME_DRIVER_AUTO     0	/* detected from the first HT frames */
+#define AIRTIME_DRIVER_GENERIC  1	/* any of the conventions below */
+#define AIRTIME_DRIVER_BROADCOM 2	/* every subframe has the PPDU's TSF */
+#define AIRTIME_DRIVER_INTEL    3	/* TSF on the first subframe, then 0 */
+#define AIRTIME_DRIVER_QCA      4	/* TSF -1 until the last, stamped at the end */
+#define AIRTIME_DRIVERS         5
+
+struct airtime_config {
+	u_int64_t interval;			/* report interval (us), 0 = whole capture */
+	size_t arena_cap;			/* bytes per table arena, 0 = default */
+	FILE *report;				/* interval reports, NULL = none */
+	u_int8_t driver;			/* AIRTIME_DRIVER_* */
+};
+
+struct airtime_snapshot {
+	u_int64_t frames;			/* frames analyzed */
+	u_int64_t airtime;			/* us, since airtime_create() */
+	u_int64_t corrupted_airtime;	/* part of it spent on bad-FCS frames */
+	u_int64_t inferred_airtime;	/* missed control responses, not in airtime */
+	u_int64_t inferred_responses;
+	u_int64_t tsf_busy;			/* us of TSF time with a frame on air */
+	u_int64_t tsf_span;			/* us of TSF time covered, utilization = busy / span */
+	u_int8_t driver;			/* AIRTIME_DRIVER_* in use, AUTO while probing */
+	unsigned int interval_no;	/* current report interval */
+	u_int64_t interval_start;	/* its start, capture time (us) */
+	u_int64_t interval_airtime;	/* its airtime so far */
+};
+
+AIRTIME_API struct airtime *airtime_create(const struct airtime_config *cfg);
+
+AIRTIME_API int airtime_feed(struct airtime *at, const struct airtime_frame *frame);
+
+AIRTIME_API unsigned int airtime_feed_batch(struct airtime *at,
+											const struct airtime_frame *frames,
+											unsigned int count);
+
+AIRTIME_API void airtime_snapshot(struct airtime *at, struct airtime_snapshot *snap);
+
+AIRTIME_API void airtime_destroy(struct airtime *at);
+
+#endif
@@ -0,0 +1,202 @@
+#ifndef _MAC_HEADER_H
+#define _MAC_HEADER_H
+
+#include <sys/types.h>
+#include "le_byteshift.h"
+
+/*
+ * 802.11 MAC header access.
+ * @mac points right after the radiotap header and @caplen is the number
+ * of captured bytes from there; every accessor checks it so a short
+ * snapshot never reads past the captured data.
+ */
+
+#define IEEE80211_FTYPE_MGMT 0
+#define IEEE80211_FTYPE_CTL  1
+#define IEEE80211_FTYPE_DATA 2
+
+#define IEEE80211_FCTL_TODS   0x0100
+#define IEEE80211_FCTL_FROMDS 0x0200
+#define IEEE80211_FCTL_RETRY  0x0800
+
+#define IEEE80211_STYPE_QOS_DATA 0x08	/* subtype bit of QoS data frames */
+
+#define IEEE80211_STYPE_BACK_REQ 8
+#define IEEE80211_STYPE_BACK     9
+#define IEEE80211_STYPE_PSPOLL   10
+#define IEEE80211_STYPE_RTS      11
+#define IEEE80211_STYPE_CTS      12
+#define IEEE80211_STYPE_ACK      13
+
+#define IEEE80211_STYPE_ACTION_NOACK 14	/* management */
+
+/* Ack Policy of the QoS Control field */
+#define IEEE80211_QOS_ACK_NORMAL 0	/* implicit BlockAck request in an A-MPDU */
+#define IEEE80211_QOS_ACK_NONE   1
+#define IEEE80211_QOS_ACK_PSMP   2
+#define IEEE80211_QOS_ACK_BLOCK  3
+
+#define MAC_ADDR_LEN 6
+
+static inline u_int16_t mac_frame_control(const u_int8_t *mac){
+	return get_unaligned_le16(mac);
+}
+
+static inline u_int8_t mac_fc_type(u_int16_t fc){
+	return (fc >> 2) & 0x3;
+}
+
+static inline u_int8_t mac_fc_subtype(u_int16_t fc){
+	return (fc >> 4) & 0xf;
+}
+
+/**
+ * mac_ra - receiver address (address 1).
+ * @mac: MAC header.
+ * @caplen: captured bytes from @mac.
+ *
+ * Return: pointer to the address, NULL if not captured.
+ */
+static inline const u_int8_t *mac_ra(const u_int8_t *mac, unsigned int caplen){
+	if (caplen < 4 + MAC_ADDR_LEN)
+		return NULL;
+	return mac + 4;
+}
+
+/**
+ * mac_ta - transmitter address (address 2).
+ * CTS and ACK frames only carry the receiver address.
+ * @mac: MAC header.
+ * @caplen: captured bytes from @mac.
+ *
+ * Return: pointer to the address, NULL if absent or not captured.
+ */
+static inline const u_int8_t *mac_ta(const u_int8_t *mac, unsigned int caplen){
+	u_int16_t fc;
+
+	if (caplen < 10 + MAC_ADDR_LEN)
+		return NULL;
+	fc = mac_frame_control(mac);
+	if (mac_fc_type(fc) == IEEE80211_FTYPE_CTL &&
+		(mac_fc_subtype(fc) == IEEE80211_STYPE_CTS ||
+		 mac_fc_subtype(fc) == IEEE80211_STYPE_ACK))
+		return NULL;
+	return mac + 10;
+}
+
+/**
+ * mac_bssid - BSSID of a management or data frame.
+ * Control frames do not say which BSS they belong to, four-address
+ * (WDS) data frames carry no BSSID and the wildcard (broadcast) BSSID of
+ * probe requests names no BSS.
+ * @mac: MAC header.
+ * @caplen: captured bytes from @mac.
+ *
+ * Return: pointer to the BSSID, NULL if absent or not captured.
+ */
+static inline const u_int8_t *mac_bssid(const u_int8_t *mac, unsigned int caplen){
+	const u_int8_t *bssid = NULL;
+	u_int16_t fc;
+
+	if (caplen < 16 + MAC_ADDR_LEN)
+		return NULL;
+	fc = mac_frame_control(mac);
+
+	switch (mac_fc_type(fc)){
+		case IEEE80211_FTYPE_MGMT:
+			bssid = mac + 16;
+			break;
+		case IEEE80211_FTYPE_DATA:
+			switch (fc & (IEEE80211_FCTL_TODS | IEEE80211_FCTL_FROMDS)){
+				case 0:
+					bssid = mac + 16;
+					break;
+				case IEEE80211_FCTL_TODS:
+					bssid = mac + 4;
+					break;
+				case IEEE80211_FCTL_FROMDS:
+					bssid = mac + 10;
+					break;
+			}
+			break;
+	}
+	if (bssid != NULL && (bssid[0] & 0x01))
+		return NULL;
+	return bssid;
+}
+
+/**
+ * mac_seq_ctrl - Sequence Control field of a management or data frame.
+ * @mac: MAC header.
+ * @caplen: captured bytes from @mac.
+ * @seq_ctrl: sequence number << 4 | fragment number.
+ *
+ * Return: 1 if the frame has one and it was captured, 0 otherwise.
+ */
+static inline int mac_seq_ctrl(const u_int8_t *mac, unsigned int caplen, u_int16_t *seq_ctrl){
+	if (caplen < 24 || mac_fc_type(mac_frame_control(mac)) == IEEE80211_FTYPE_CTL)
+		return 0;
+	*seq_ctrl = get_unaligned_le16(mac + 22);
+	return 1;
+}
+
+/**
+ * mac_qos_control - QoS Control field of a QoS data frame.
+ * The QoS Control field follows address 4 when both ToDS and FromDS
+ * are set.
+ * @mac: MAC header.
+ * @caplen: captured bytes from @mac.
+ * @qos_ctrl: the field.
+ *
+ * Return: 1 if the frame has one and it was captured, 0 otherwise.
+ */
+static inline int mac_qos_control(const u_int8_t *mac, unsigned int caplen, u_int16_t *qos_ctrl){
+	unsigned int offset = 24;
+	u_int16_t fc;
+
+	if (caplen < 2)
+		return 0;
+	fc = mac_frame_control(mac);
+	if (mac_fc_type(fc) != IEEE80211_FTYPE_DATA ||
+		!(mac_fc_subtype(fc) & IEEE80211_STYPE_QOS_DATA))
+		return 0;
+	if ((fc & (IEEE80211_FCTL_TODS | IEEE80211_FCTL_FROMDS)) ==
+		(IEEE80211_FCTL_TODS | IEEE80211_FCTL_FROMDS))
+		offset += MAC_ADDR_LEN;
+	if (caplen < offset + 2)
+		return 0;
+	*qos_ctrl = get_unaligned_le16(mac + offset);
+	return 1;
+}
+
+/**
+ * mac_qos_tid - TID of a QoS data frame.
+ * @mac: MAC header.
+ * @caplen: captured bytes from @mac.
+ *
+ * Return: TID (0 to 15), -1 if not a QoS data frame or not captured.
+ */
+static inline int mac_qos_tid(const u_int8_t *mac, unsigned int caplen){
+	u_int16_t qos_ctrl;
+
+	if (!mac_qos_control(mac, caplen, &qos_ctrl))
+		return -1;
+	return qos_ctrl & 0x0f;
+}
+
+/**
+ * mac_qos_ack_policy - Ack Policy subfield of a QoS data frame.
+ * @mac: MAC header.
+ * @caplen: captured bytes from @mac.
+ *
+ * Return: IEEE80211_QOS_ACK_*, -1 if not a QoS data frame or not captured.
+ */
+static inline int mac_qos_ack_policy(const u_int8_t *mac, unsigned int caplen){
+	u_int16_t qos_ctrl;
+
+	if (!mac_qos_control(mac, caplen, &qos_ctrl))
+		return -1;
+	return (qos_ctrl >> 5) & 0x3;
+}
+
+#endif
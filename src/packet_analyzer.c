@@ -1,52 +1,302 @@
 #include <errno.h>
 #include <time.h>
 #include <stdlib.h>
+#include <string.h>
 #include "packet_analyzer.h"
 #include "ieee80211_radiotap.h"
 #include "endian_converter.h"
 #include "cfg80211.h"
 #include "ieee80211.h"
+#include "mac_header.h"
+#include "frame_log.h"
+#include "channel_stats.h"
+#include "duration_hist.h"
+#include "stage_timing.h"
+#include "sampler.h"
+#include "frame_types.h"
+#include "retry_stats.h"
+#include "wmm_stats.h"
+#include "response_infer.h"
+#include "tsf_util.h"
+#include "driver_profile.h"
+#include "debug.h"
 
 #define MAXUINT64 0xffffffffffffffff
-static struct previous_frame_info prev_frame;
-static u_int8_t current_aggregate = 0;
-static u_int8_t is_first_frame = 1; /* use to identify the first captured frame */
-static u_int8_t is_second_subframe = 0; /* use to identify the second subframe
-										   in an aggregate */
-static unsigned int pkt_no = 0; /* packet number */
+
+/* largest MPDUs, bad-FCS frames are never costed longer */
+#define MAX_MPDU_LEN_LEGACY 2346	/* 2304 byte body, header, security, FCS */
+#define MAX_MPDU_LEN_HT     7975	/* 7935 byte A-MSDU, 4-address QoS header
+									   with HT Control, FCS */
+
+static void check_interval(struct arguments *args, u_int64_t ts);
+static void end_due_interval(struct arguments *args);
+static u_int8_t in_ampdu(struct analyzer_state *st, const struct ieee_802_11_phdr *phdr);
+
+/**
+ * log_frame - fill in the frame log record of a frame.
+ * @rec: record.
+ * @ts: capture timestamp (us).
+ * @mac: pointer to the MAC header (right after radiotap).
+ * @mac_caplen: captured bytes from @mac.
+ * @phdr: physical header info.
+ * @length: MPDU length, including FCS.
+ * @duration: duration charged to the frame.
+ * @in_aggregate: equal 1 if the frame is an A-MPDU subframe.
+ * @flags: more FRAME_LOG_F_* flags of the frame.
+ */
+static void log_frame(struct frame_log_record *rec, u_int64_t ts,
+					  const u_char *mac, unsigned int mac_caplen,
+					  const struct ieee_802_11_phdr *phdr,
+					  unsigned int length, unsigned int duration,
+					  u_int8_t in_aggregate, u_int8_t flags){
+	const u_int8_t *addr;
+
+	memset(rec, 0, sizeof(*rec));
+	rec->ts_usec = ts;
+	rec->length = length;
+	rec->duration = duration;
+	rec->phy = phdr->phy;
+	rec->mcs = 0xff;
+	rec->bw = 0xff;
+	rec->gi = 0xff;
+
+	if (phdr->has_tsf_timestamp){
+		rec->tsf = phdr->tsf_timestamp;
+		rec->flags |= FRAME_LOG_F_TSF;
+	}
+	if (phdr->has_aggregate_info){
+		rec->aggregate_id = phdr->aggregate_id;
+		rec->flags |= FRAME_LOG_F_AGG_ID;
+	}
+	if (in_aggregate)
+		rec->flags |= FRAME_LOG_F_AGGREGATE;
+	rec->flags |= flags;
+	if (phdr->has_data_rate)
+		rec->rate = phdr->data_rate;
+
+	if (phdr->phy == PHDR_802_11_PHY_11N){
+		const struct ieee_802_11n *_n = &(phdr->phy_info.info_11n);
+		if (_n->has_mcs_index)
+			rec->mcs = _n->mcs_index;
+		if (_n->has_bandwidth)
+			rec->bw = _n->bandwidth;
+		if (_n->has_short_gi)
+			rec->gi = _n->short_gi;
+	}
+
+	if ((addr = mac_ra(mac, mac_caplen)) != NULL){
+		memcpy(rec->ra, addr, MAC_ADDR_LEN);
+		rec->flags |= FRAME_LOG_F_RA;
+	}
+	if ((addr = mac_ta(mac, mac_caplen)) != NULL){
+		memcpy(rec->ta, addr, MAC_ADDR_LEN);
+		rec->flags |= FRAME_LOG_F_TA;
+	}
+}
 
 /**
- * got_packet - callback function that will be put in to pcap_loop()
+ * ampdu_fits - check that a frame taken for the next subframe can still
+ * belong to the open PPDU.
+ * @acc: accumulator.
+ * @length: MPDU length of the frame.
+ * @ts: capture timestamp (us) of the frame.
+ *
+ * Return: 0 if the PPDU would grow past the longest A-MPDU, in bytes or
+ * subframes, or its last subframe came too long ago: the tail of the
+ * PPDU was lost and the frame opens another one.
+ */
+static u_int8_t ampdu_fits(const struct ampdu_acc *acc, unsigned int length,
+						   u_int64_t ts){
+	return acc->open && ts <= acc->last_ts + AMPDU_TIMEOUT &&
+		   acc->frames < AMPDU_MAX_FRAMES &&
+		   acc->length + 4 + length <= AMPDU_MAX_LEN_HT;
+}
+
+/**
+ * ampdu_add - add a frame to the PPDU being received.
+ * @acc: accumulator.
+ * @phdr: physical header info of the frame.
+ * @length: MPDU length, including FCS.
+ * @in_aggregate: equal 1 if the frame continues the open PPDU, else it
+ * opens a new one.
+ * @bad_fcs: equal 1 if the frame failed CRC.
+ * @ts: capture timestamp (us).
+ *
+ * Return: the subframe, for the caller to fill in how it was accounted.
+ */
+static struct ampdu_frame *ampdu_add(struct ampdu_acc *acc,
+									 const struct ieee_802_11_phdr *phdr,
+									 unsigned int length, u_int8_t in_aggregate,
+									 u_int8_t bad_fcs, u_int64_t ts){
+	struct ampdu_frame *fr;
+
+	if (!in_aggregate || !acc->open){
+		acc->open = 1;
+		acc->phdr = *phdr;
+		acc->length = 0;
+		acc->frames = 0;
+	}
+	/* delimiter before, padding to 4 bytes after each subframe */
+	acc->last_pad = -length & 3;
+	acc->length += 4 + length + acc->last_pad;
+	acc->last_ts = ts;
+
+	fr = &acc->frame[acc->frames];
+	fr->length = length;
+	fr->in_aggregate = acc->frames != 0;
+	fr->bad_fcs = bad_fcs;
+	acc->frames++;
+	return fr;
+}
+
+/**
+ * ampdu_is_last - check if the frame is known to end its PPDU.
+ * @phdr: physical header info of the frame.
+ * @prev: previous frame info.
+ * @in_aggregate: equal 1 if the frame continues the previous PPDU.
+ *
+ * Return: 1 if radiotap flags the frame as the last subframe, or if it
+ * is the subframe with the TSF after subframes stamped -1 (QCA).
+ */
+static u_int8_t ampdu_is_last(const struct ieee_802_11_phdr *phdr,
+							  const struct previous_frame_info *prev,
+							  u_int8_t in_aggregate){
+	if (phdr->has_aggregate_info &&
+		(phdr->aggregate_flags & IEEE80211_RADIOTAP_AMPDU_LAST_KNOWN))
+		return (phdr->aggregate_flags & IEEE80211_RADIOTAP_AMPDU_IS_LAST) != 0;
+	return in_aggregate && prev->tsf_timestamp == MAXUINT64 &&
+		   phdr->has_tsf_timestamp && phdr->tsf_timestamp != MAXUINT64;
+}
+
+/**
+ * ampdu_cost - airtime of the PPDU in the accumulator, computed once for
+ * the whole PSDU: a single MPDU goes without delimiter, and the last
+ * subframe of an A-MPDU without padding.
+ * @acc: accumulator.
+ *
+ * Return: duration (us).
+ */
+static unsigned int ampdu_cost(struct ampdu_acc *acc){
+	unsigned int psdu_length = acc->length - acc->last_pad;
+
+	if (acc->frames == 1)
+		psdu_length -= 4;
+	return calculate_duration(&acc->phdr, psdu_length, 0, 0);
+}
+
+/**
+ * ampdu_split - charge each subframe of a PPDU, accounted with no
+ * airtime, its share of the PSDU bytes in the PPDU's airtime, the way
+ * the subframe was accounted. Histograms and the frame log get the
+ * subframes here.
+ * @args: user's arguments.
+ * @acc: accumulator of the PPDU.
+ * @duration: ampdu_cost() of the PPDU.
+ */
+static void ampdu_split(struct arguments *args, const struct ampdu_acc *acc,
+						unsigned int duration){
+	unsigned int key = duration_hists_key(&acc->phdr);
+	unsigned int charged = 0, share, i;
+	u_int32_t bytes = 0;
+
+	for (i = 0; i < acc->frames; i++){
+		const struct ampdu_frame *fr = &acc->frame[i];
+
+		/* shares of the bytes so far, so they add up to the duration */
+		bytes += 4 + fr->length + (-fr->length & 3);
+		share = (u_int64_t)duration * bytes / acc->length - charged;
+		charged += share;
+
+		frame_types_adjust(&args->frame_types, fr->type, share);
+		wmm_stats_adjust(&args->wmm, fr->ac, share);
+		retry_stats_adjust(&args->retries, fr->retry, fr->ac, share);
+		if (fr->bad_fcs){
+			args->interval_corrupted.airtime += share;
+			args->corrupted_airtime += share;
+		}
+		if (args->hists != NULL)
+			duration_hists_add(args->hists, key, share, fr->length, fr->in_aggregate);
+		if (args->frame_log != NULL){
+			struct frame_log_record rec = fr->rec;
+
+			rec.duration = share;
+			/* a write error is kept by the log, for the report */
+			frame_log_append(args->frame_log, &rec);
+		}
+	}
+}
+
+/**
+ * ampdu_close - cost the open PPDU, if any, whose last frame was
+ * accounted with no airtime: charge it to that frame as the whole PPDU,
+ * and split it across the subframes.
+ * @args: user's arguments.
+ */
+static void ampdu_close(struct arguments *args){
+	struct ampdu_acc *acc = &args->state.ampdu;
+	unsigned int duration;
+
+	if (!acc->open)
+		return;
+	acc->open = 0;
+	duration = ampdu_cost(acc);
+	args->airtime += duration;
+	args->interval_airtime += duration;
+	response_infer_adjust(&args->responses, duration);
+	tsf_util_adjust(&args->util, duration);
+	channel_stats_adjust(&args->chan_stats, duration);
+	ampdu_split(args, acc, duration);
+}
+
+/**
+ * analyzer_feed - analyze one frame, in capture order.
  * Identify physical info of the packet, calculate frame length,
  * call to duration calculation function.
- * @argv: pointer to user's arguments.
- * @header: pointer to pcap packet header.
- * @packet: pointer to real packet (include radiotap header).
+ * @args: user's arguments.
+ * @f: the frame, radiotap header included.
+ *
+ * Return: 1 if the frame was costed, 0 if it was left out (not sampled,
+ * or a malformed radiotap header).
  */
-void got_packet(u_char *argv, const struct pcap_pkthdr *header, const u_char *packet){
-	struct arguments *args = (struct arguments*)argv;
-	u_char *dumper = (u_char*)(args->dumper);
-	pcap_dump(dumper, header, packet);
+int analyzer_feed(struct arguments *args, const struct airtime_frame *f){
+	struct analyzer_state *st = &args->state;
+	const u_char *packet = f->data;
+	STAGE_START(t);
+	check_interval(args, f->ts_usec);
+
+	if (!sampler_take(&args->sampler, packet, f->caplen, f->ts_usec, args->airtime)){
+		/* the next sampled PPDU must not be matched against the last
+		 * analyzed frame */
+		ampdu_close(args);
+		end_due_interval(args);
+		st->is_first_frame = 1;
+		st->current_aggregate = 0;
+		response_infer_forget(&args->responses);
+		tsf_util_forget(&args->util);
+		return 0;
+	}
+	if (f->caplen < sizeof(struct ieee80211_radiotap_header))
+		return 0;
 
 	struct ieee80211_radiotap_header *hdr;
 	hdr = (struct ieee80211_radiotap_header*)(packet);
 	//convert to the local endian
-	u_int16_t rtap_hdr_len = le2local16(hdr->it_len);
+	u_int16_t rtap_hdr_len = get_unaligned_le16(&hdr->it_len);
 
-	pkt_no++;	
-	fprintf(stderr,"No: %u =======================================\n", pkt_no);
-	fprintf(stderr,"len: %u\n", header->len);
-	fprintf(stderr,"present bits: %u\n", hdr->it_present);
-	fprintf(stderr,"rtap header length: %u\n", rtap_hdr_len);
+	st->pkt_no++;	
+	pr_debug("No: %u =======================================\n", st->pkt_no);
+	pr_debug("len: %u\n", f->len);
+	pr_debug("present bits: %u\n", get_unaligned_le32(&hdr->it_present));
+	pr_debug("rtap header length: %u\n", rtap_hdr_len);
 
-	if (is_first_frame){
+	if (st->is_first_frame){
 		/* This is the first frame of the capturing.
 		 * An aggregate is identifiable only from the second subframe.*/
-		is_first_frame = 0;
-		fprintf(stderr, "This is the first frame\n");
+		st->is_first_frame = 0;
+		pr_debug("This is the first frame\n");
 	}
-	struct MCS_radiotap_header *mcsInfo = NULL;
-	struct channel_radiotap_header *chanInfo = NULL;
+	struct rtap_mcs_view mcsInfo = { .p = NULL };
+	struct rtap_channel_view chanInfo;
 	u_int8_t bandwidth;
 	u_int8_t flags_rtap = 0;
 
@@ -70,13 +320,14 @@ void got_packet(u_char *argv, const struct pcap_pkthdr *header, const u_char *pa
 		u_int8_t short_preamble:1;
 		u_int8_t short_gi:1;
 		u_int8_t fcs_at_end:1;
+		u_int8_t bad_fcs:1;
 	} checker = {.has_fhss = 0, .is_2ghz = 0, .is_5ghz = 0, .is_ofdm = 0,
 					.has_mcs = 0, .has_vht = 0, .cck_ofdm = 0, .short_gi = 0,
-					.short_preamble = 0, .fcs_at_end = 0};
+					.short_preamble = 0, .fcs_at_end = 0, .bad_fcs = 0};
 
 
 	struct ieee80211_radiotap_iterator iter;
-	int ret = ieee80211_radiotap_iterator_init(&iter, hdr, hdr->it_len, NULL);
+	int ret = ieee80211_radiotap_iterator_init(&iter, hdr, f->caplen, NULL);
 
 	while (ret == 0) {
 
@@ -90,10 +341,10 @@ void got_packet(u_char *argv, const struct pcap_pkthdr *header, const u_char *pa
 
 		if (this_arg_index == IEEE80211_RADIOTAP_RATE){
 			phdr.has_data_rate = 1;
-			phdr.data_rate = *(iter.this_arg);
+			phdr.data_rate = rtap_u8(iter.this_arg);
 			
-			fprintf(stderr,"rate -------------------\n");
-			fprintf(stderr, "rate: %d\n", phdr.data_rate);	
+			pr_debug("rate -------------------\n");
+			pr_debug("rate: %d\n", phdr.data_rate);	
 		}
 		else if (this_arg_index == IEEE80211_RADIOTAP_FHSS){
 			checker.has_fhss = 1;
@@ -101,10 +352,11 @@ void got_packet(u_char *argv, const struct pcap_pkthdr *header, const u_char *pa
 		}
 		else if (this_arg_index == IEEE80211_RADIOTAP_CHANNEL){
 			//radiotap channel info
-			chanInfo = (struct channel_radiotap_header*)(iter.this_arg);
-			//convert to local endian
-			u_int16_t frequency = le2local16(chanInfo->frequency);
-			u_int16_t chan_flags = le2local16(chanInfo->flags);
+			chanInfo = rtap_channel(iter.this_arg);
+			u_int16_t frequency = rtap_channel_frequency(chanInfo);
+			u_int16_t chan_flags = rtap_channel_flags(chanInfo);
+			phdr.has_frequency = 1;
+			phdr.frequency = frequency;
 
 			checker.is_ofdm = get_sub_value(chan_flags, IEEE80211_CHAN_OFDM);
 			checker.is_cck = get_sub_value(chan_flags, IEEE80211_CHAN_CCK);
@@ -113,53 +365,53 @@ void got_packet(u_char *argv, const struct pcap_pkthdr *header, const u_char *pa
 			checker.is_5ghz = get_sub_value(chan_flags, IEEE80211_CHAN_5GHZ);
 			checker.cck_ofdm = get_sub_value(chan_flags, IEEE80211_CHAN_DYN);
 
-			fprintf(stderr,"channel info ----------------------\n");
-			fprintf(stderr,"frequency: %u\n", frequency);
-			fprintf(stderr,"CCK: %u\n", checker.is_cck);
-			fprintf(stderr,"OFDM: %u\n", checker.is_ofdm);
-			fprintf(stderr, "is_2ghz: %u\n", checker.is_2ghz);
-			fprintf(stderr, "is_5ghz: %u\n", checker.is_5ghz);
-			fprintf(stderr, "cck_ofdm: %u\n", checker.cck_ofdm);
+			pr_debug("channel info ----------------------\n");
+			pr_debug("frequency: %u\n", frequency);
+			pr_debug("CCK: %u\n", checker.is_cck);
+			pr_debug("OFDM: %u\n", checker.is_ofdm);
+			pr_debug("is_2ghz: %u\n", checker.is_2ghz);
+			pr_debug("is_5ghz: %u\n", checker.is_5ghz);
+			pr_debug("cck_ofdm: %u\n", checker.cck_ofdm);
 		}
 		else if (this_arg_index == IEEE80211_RADIOTAP_TSFT){
 			/* Time synchronization function info */
 			phdr.has_tsf_timestamp = 1;
-			phdr.tsf_timestamp = le2local64(*(iter.this_arg));
+			phdr.tsf_timestamp = rtap_tsft_value(rtap_tsft(iter.this_arg));
 
-			fprintf(stderr, "TSFT info ------------------------\n");
-			fprintf(stderr, "tsf timestamp: %ld\n", phdr.tsf_timestamp);
+			pr_debug("TSFT info ------------------------\n");
+			pr_debug("tsf timestamp: %ld\n", phdr.tsf_timestamp);
 		}
 		else if (this_arg_index == IEEE80211_RADIOTAP_AMPDU_STATUS){
 			/* A-MPDU info */
 			phdr.has_aggregate_info = 1;
-			struct A_MPDU_radiotap_header *ampdu 
-					= (struct A_MPDU_radiotap_header*)(iter.this_arg);
-			phdr.aggregate_flags = ampdu->flags;
-			phdr.aggregate_id = le2local32(ampdu->reference_num);
-
-			fprintf(stderr, "AMPDU status ------------------------\n");
-			fprintf(stderr, "aggregate flags: %u\n", phdr.aggregate_flags);
-			fprintf(stderr, "aggregate id: %u\n", phdr.aggregate_id);
+			struct rtap_ampdu_view ampdu = rtap_ampdu(iter.this_arg);
+			phdr.aggregate_flags = rtap_ampdu_flags(ampdu);
+			phdr.aggregate_id = rtap_ampdu_reference(ampdu);
+
+			pr_debug("AMPDU status ------------------------\n");
+			pr_debug("aggregate flags: %u\n", phdr.aggregate_flags);
+			pr_debug("aggregate id: %u\n", phdr.aggregate_id);
 		}
 		else if (this_arg_index == IEEE80211_RADIOTAP_MCS){
 			//radiotap mcs info
-			mcsInfo = (struct MCS_radiotap_header*)(iter.this_arg);
-			checker.short_gi = get_sub_value(mcsInfo->flags, IEEE80211_RADIOTAP_MCS_SGI);
+			mcsInfo = rtap_mcs(iter.this_arg);
+			checker.short_gi = get_sub_value(rtap_mcs_flags(mcsInfo), IEEE80211_RADIOTAP_MCS_SGI);
 			checker.has_mcs = 1;
 		
-			fprintf(stderr,"mcs info -----------------------\n");
-			fprintf(stderr,"mcs: %u\n", mcsInfo->mcs);
-			fprintf(stderr,"short GI: %u\n", checker.short_gi);
+			pr_debug("mcs info -----------------------\n");
+			pr_debug("mcs: %u\n", rtap_mcs_index(mcsInfo));
+			pr_debug("short GI: %u\n", checker.short_gi);
 		}
 		else if (this_arg_index == IEEE80211_RADIOTAP_FLAGS){
 			//radiotap flags info
-			flags_rtap = *(iter.this_arg);
+			flags_rtap = rtap_u8(iter.this_arg);
 			checker.short_preamble = get_sub_value(flags_rtap, IEEE80211_RADIOTAP_F_SHORTPRE);
 			checker.fcs_at_end = get_sub_value(flags_rtap, IEEE80211_RADIOTAP_F_FCS);
+			checker.bad_fcs = get_sub_value(flags_rtap, IEEE80211_RADIOTAP_F_BADFCS);
 
-			fprintf(stderr,"flags info -----------------------\n");
-			fprintf(stderr,"short preamble: %u\n", checker.short_preamble);
-			fprintf(stderr, "fcs at end: %u\n", checker.fcs_at_end);
+			pr_debug("flags info -----------------------\n");
+			pr_debug("short preamble: %u\n", checker.short_preamble);
+			pr_debug("fcs at end: %u\n", checker.fcs_at_end);
 			
 		}
 		else if (this_arg_index == IEEE80211_RADIOTAP_VHT){
@@ -169,20 +421,31 @@ void got_packet(u_char *argv, const struct pcap_pkthdr *header, const u_char *pa
 	}
 
 
+	STAGE_END(t, STAGE_RADIOTAP);
+
 	if (ret != -ENOENT){
-		fprintf(stderr,"max_length error %d\n", ret);
-		return;
+		pr_debug("max_length error %d\n", ret);
+		return 0;
 	}
 
-	unsigned int frame_length = header->len - rtap_hdr_len;
+	unsigned int frame_length = f->len > rtap_hdr_len ? f->len - rtap_hdr_len : 0;
 
 	if (!checker.fcs_at_end)
 		frame_length += 4;
-
-	u_int8_t can_calculate = 1; /* use with A-MPDU,
-								   accummulate A-MPDU length,
-								   calculate duration at once
-								   at the arival of the last subframe */
+	const u_char *mac = packet + rtap_hdr_len;
+	unsigned int mac_caplen = f->caplen > rtap_hdr_len ?
+							  f->caplen - rtap_hdr_len : 0;
+
+	if (checker.bad_fcs){
+		/* The frame failed CRC: only what the PHY reported (radiotap rate,
+		 * MCS, TSF, length) is trusted. The MAC header is hidden from
+		 * the accounting, and the length is capped to the largest MPDU. */
+		unsigned int max_length = checker.has_mcs || checker.has_vht ?
+								  MAX_MPDU_LEN_HT : MAX_MPDU_LEN_LEGACY;
+		if (frame_length > max_length)
+			frame_length = max_length;
+		mac_caplen = 0;
+	}
 	u_int8_t in_aggregate = 0;
 
 	/* determine physical type.
@@ -238,7 +501,7 @@ void got_packet(u_char *argv, const struct pcap_pkthdr *header, const u_char *pa
 	}
 	else if (checker.has_mcs && !checker.has_vht){
 		//802.11n
-		fprintf(stderr, "802.11n info .-.-.-.-.-..-.-.-.-.-.-.-.-\n");
+		pr_debug("802.11n info .-.-.-.-.-..-.-.-.-.-.-.-.-\n");
 
 		phdr.phy = PHDR_802_11_PHY_11N;
 		phdr.phy_info.info_11n.has_bandwidth = 0;
@@ -250,77 +513,61 @@ void got_packet(u_char *argv, const struct pcap_pkthdr *header, const u_char *pa
 		phdr.phy_info.info_11n.has_mcs_index = 0;
 
 		struct ieee_802_11n *_n = &(phdr.phy_info.info_11n);
-		if (get_sub_value(mcsInfo->known, IEEE80211_RADIOTAP_MCS_HAVE_MCS)){
+		u_int8_t mcs_known = rtap_mcs_known(mcsInfo);
+		u_int8_t mcs_flags = rtap_mcs_flags(mcsInfo);
+		if (get_sub_value(mcs_known, IEEE80211_RADIOTAP_MCS_HAVE_MCS)){
 			_n->has_mcs_index = 1;
-			_n->mcs_index = mcsInfo->mcs;
-			fprintf(stderr, "mcs index: %u\n", _n->mcs_index);
+			_n->mcs_index = rtap_mcs_index(mcsInfo);
+			pr_debug("mcs index: %u\n", _n->mcs_index);
 		}
-		if (get_sub_value(mcsInfo->known, IEEE80211_RADIOTAP_MCS_HAVE_BW)){
+		if (get_sub_value(mcs_known, IEEE80211_RADIOTAP_MCS_HAVE_BW)){
 			_n->has_bandwidth = 1;
-			_n->bandwidth = get_sub_value(mcsInfo->flags, IEEE80211_RADIOTAP_MCS_BW_MASK);
-			fprintf(stderr, "bandwidth: %u\n", _n->bandwidth);
+			_n->bandwidth = get_sub_value(mcs_flags, IEEE80211_RADIOTAP_MCS_BW_MASK);
+			pr_debug("bandwidth: %u\n", _n->bandwidth);
 		}
-		if (get_sub_value(mcsInfo->known, IEEE80211_RADIOTAP_MCS_HAVE_GI)){
+		if (get_sub_value(mcs_known, IEEE80211_RADIOTAP_MCS_HAVE_GI)){
 			_n->has_short_gi = 1;
-			_n->short_gi = get_sub_value(mcsInfo->flags, IEEE80211_RADIOTAP_MCS_SGI);
-			fprintf(stderr, "short_gi: %u\n", _n->short_gi);
+			_n->short_gi = get_sub_value(mcs_flags, IEEE80211_RADIOTAP_MCS_SGI);
+			pr_debug("short_gi: %u\n", _n->short_gi);
 		}
-		if (get_sub_value(mcsInfo->known, IEEE80211_RADIOTAP_MCS_HAVE_FMT)){
+		if (get_sub_value(mcs_known, IEEE80211_RADIOTAP_MCS_HAVE_FMT)){
 			_n->has_greenfield = 1;
-			_n->greenfield = get_sub_value(mcsInfo->flags, IEEE80211_RADIOTAP_MCS_FMT_GF);	
-			fprintf(stderr, "greenfield: %u\n", _n->greenfield);
+			_n->greenfield = get_sub_value(mcs_flags, IEEE80211_RADIOTAP_MCS_FMT_GF);	
+			pr_debug("greenfield: %u\n", _n->greenfield);
 		}
-		if (get_sub_value(mcsInfo->known, IEEE80211_RADIOTAP_MCS_HAVE_FEC)){
+		if (get_sub_value(mcs_known, IEEE80211_RADIOTAP_MCS_HAVE_FEC)){
 			_n->has_fec = 1;
-			_n->fec = get_sub_value(mcsInfo->flags, IEEE80211_RADIOTAP_MCS_FEC_LDPC);
-			fprintf(stderr, "fec: %u\n", _n->fec);
+			_n->fec = get_sub_value(mcs_flags, IEEE80211_RADIOTAP_MCS_FEC_LDPC);
+			pr_debug("fec: %u\n", _n->fec);
 		}
-		if (get_sub_value(mcsInfo->known, IEEE80211_RADIOTAP_MCS_HAVE_STBC)){
+		if (get_sub_value(mcs_known, IEEE80211_RADIOTAP_MCS_HAVE_STBC)){
 			_n->has_stbc_streams = 1;
-			_n->stbc_streams = get_sub_value(mcsInfo->flags, IEEE80211_RADIOTAP_MCS_STBC_MASK);
-			fprintf(stderr, "stbc_streams: %u\n", _n->stbc_streams);
+			_n->stbc_streams = get_sub_value(mcs_flags, IEEE80211_RADIOTAP_MCS_STBC_MASK);
+			pr_debug("stbc_streams: %u\n", _n->stbc_streams);
 		}
-		if (get_sub_value(mcsInfo->known, 0x40)){
+		if (get_sub_value(mcs_known, 0x40)){
 			/* extension spatial streams */
 			_n->has_ness = 1;
-			_n->ness = get_sub_value(mcsInfo->flags, 0x80);
-			fprintf(stderr, "ness: %u\n", _n->ness);
+			_n->ness = get_sub_value(mcs_flags, 0x80);
+			pr_debug("ness: %u\n", _n->ness);
 		}
 
-		if (!is_first_frame) {
+		STAGE_END(t, STAGE_CLASSIFY);
+		if (!st->is_first_frame) {
 			/* An aggregate is identifiable only from the second subframe.*/
-			in_aggregate = in_ampdu(&phdr);
-
-			if (in_aggregate){
-				/* This frame is a part of the A-MPDU */
-				/* add A-MPDU delimiter */
-				frame_length += 4;
-
-				if (is_second_subframe){
-					/* This is the second frame of the A-MPDU
-					 * -> need to add padding to the first frame if neccessary.
-					 * add delimiter for the first frame*/
-					prev_frame.prev_length = (prev_frame.prev_length | 3) + 1;
-					prev_frame.prev_length += 4;
-
-					/* The first frame (identified as non A-MPDU) duration
-					 * has been added to the total airtime,
-					 * so subtract it's duration from the total airtime
-					 * so that we can calculate it's duration
-					 * as a part of the A-MPDU */
-					args->airtime -= prev_frame.duration;
-
-					/* re-calculate the first subframe duration */
-					prev_frame.duration = calculate_duration(&phdr, prev_frame.prev_length, 1, 1);
-					args->airtime += prev_frame.duration;
-					fprintf(stderr, "####### prev_frame duration #######\n");
-					fprintf(stderr, "#       duration: %u             #\n", prev_frame.duration);
-					fprintf(stderr, "###################################\n");
-				}
-				
-				frame_length = (frame_length | 3) + 1;	
+			if (st->driver.profile == AIRTIME_DRIVER_AUTO &&
+				st->prev_frame.phy == phdr.phy &&
+				driver_profile_observe(&st->driver, &phdr, st->prev_frame.has_tsf_timestamp,
+									   st->prev_frame.tsf_timestamp))
+				args->util.ref = driver_profile_tsf_ref(st->driver.profile);
+			in_aggregate = in_ampdu(st, &phdr);
+			if (in_aggregate && !ampdu_fits(&st->ampdu, frame_length, f->ts_usec)){
+				pr_debug("The A-MPDU lost its tail, this frame starts another\n");
+				in_aggregate = 0;
+				st->current_aggregate = 0;
 			}
 		}
+		STAGE_END(t, STAGE_AMPDU);
 	}
 	else if (checker.has_vht){
 		//802.11ac
@@ -341,19 +588,270 @@ void got_packet(u_char *argv, const struct pcap_pkthdr *header, const u_char *pa
 
 
 
-	unsigned int duration = 0;
+	STAGE_END(t, STAGE_CLASSIFY);
 
-	duration = calculate_duration(&phdr, frame_length, in_aggregate, 0);
-	fprintf(stderr, "DURATION: %u\n", duration);
-	prev_frame.duration = duration;
-	prev_frame.prev_length = frame_length;
+	unsigned int duration = 0;		/* of the frame, or of its whole PPDU */
+	unsigned int corrupted = 0;
+	struct ampdu_frame *subframe = NULL;
+	u_int8_t last = 0;
+
+	/* a frame that does not continue the open PPDU closes it, and the
+	 * interval held open for the PPDU */
+	if (!in_aggregate){
+		ampdu_close(args);
+		end_due_interval(args);
+	}
+	if (phdr.phy == PHDR_802_11_PHY_11N){
+		/* HT PPDUs are costed as a whole, at their last subframe if it
+		 * is known, else when they close; their subframes get their
+		 * share then */
+		subframe = ampdu_add(&st->ampdu, &phdr, frame_length, in_aggregate,
+							 checker.bad_fcs, f->ts_usec);
+		last = ampdu_is_last(&phdr, &st->prev_frame, in_aggregate);
+		if (last){
+			duration = ampdu_cost(&st->ampdu);
+			st->ampdu.open = 0;
+		}
+	}
+	else {
+		duration = calculate_duration(&phdr, frame_length, 0, 0);
+		corrupted = checker.bad_fcs ? duration : 0;
+	}
+	pr_debug("DURATION: %u\n", duration);
+	STAGE_END(t, STAGE_DURATION);
 	args->airtime += duration;
+	args->interval_airtime += duration;
+
+	/* bad-FCS frames still occupied the medium: they stay in the total
+	 * and are counted apart as corrupted airtime */
+	if (checker.bad_fcs)
+		args->interval_corrupted.frames++;
+	args->interval_corrupted.airtime += corrupted;
+	args->corrupted_airtime += corrupted;
+
+	response_infer_frame(&args->responses, mac, mac_caplen, &phdr,
+						 in_aggregate, duration);
+	tsf_util_frame(&args->util, phdr.has_tsf_timestamp, phdr.tsf_timestamp,
+				   f->ts_usec, duration);
+
+	channel_stats_account(&args->chan_stats, phdr.has_frequency, phdr.frequency,
+						  mac_bssid(mac, mac_caplen), duration);
+
+	/* statistics per frame, not per PPDU */
+	unsigned int frame_airtime = subframe != NULL ? 0 : duration;
+
+	int type = mac_caplen >= 2 ? FRAME_TYPE_INDEX(mac_frame_control(mac)) :
+								 FRAME_TYPE_UNKNOWN;
+	frame_types_account(&args->frame_types, type, frame_airtime);
+
+	u_int16_t seq_ctrl = 0;
+	int has_seq = mac_seq_ctrl(mac, mac_caplen, &seq_ctrl);
+	int tid = mac_qos_tid(mac, mac_caplen);
+	wmm_stats_account(&args->wmm, tid_to_ac(tid), frame_airtime);
+	u_int8_t retry = retry_stats_account(&args->retries, mac_ta(mac, mac_caplen),
+										 has_seq, seq_ctrl, tid,
+										 mac_caplen >= 2 &&
+										 (mac_frame_control(mac) & IEEE80211_FCTL_RETRY),
+										 frame_airtime);
+
+	if (args->hists != NULL && subframe == NULL)
+		duration_hists_add(args->hists, duration_hists_key(&phdr), duration,
+						   frame_length, in_aggregate);
+
+	if (args->frame_log != NULL){
+		struct frame_log_record rec;
+
+		log_frame(subframe != NULL ? &subframe->rec : &rec, f->ts_usec, mac, mac_caplen,
+				  &phdr, frame_length, frame_airtime, in_aggregate,
+				  (retry & RETRY_STATS_RETRY ? FRAME_LOG_F_RETRY : 0) |
+				  (checker.bad_fcs ? FRAME_LOG_F_BAD_FCS : 0));
+		/* a write error is kept by the log, for the report */
+		if (subframe == NULL)
+			frame_log_append(args->frame_log, &rec);
+	}
+
+	if (subframe != NULL){
+		subframe->type = type;
+		subframe->ac = tid_to_ac(tid);
+		subframe->retry = retry;
+		if (last)
+			ampdu_split(args, &st->ampdu, duration);
+	}
+
+	st->prev_frame.has_tsf_timestamp = phdr.has_tsf_timestamp;
+	st->prev_frame.tsf_timestamp = phdr.tsf_timestamp;
+	st->prev_frame.phy = phdr.phy;
+	st->prev_frame.phy_info = phdr.phy_info;
+	if (last)
+		end_due_interval(args);
+	STAGE_END(t, STAGE_ACCOUNT);
+	return 1;
+}
+
+/**
+ * analyzer_init - reset the analyzer state of a capture.
+ * Output and interval settings of @args are left alone.
+ * @args: user's arguments holding the state.
+ */
+void analyzer_init(struct arguments *args){
+	memset(&args->state, 0, sizeof(args->state));
+	args->state.is_first_frame = 1;
+	driver_profile_init(&args->state.driver, args->driver);
+	args->airtime = 0;
+	args->interval_airtime = 0;
+	args->interval_start = 0;
+	memset(&args->interval_corrupted, 0, sizeof(args->interval_corrupted));
+	args->corrupted_airtime = 0;
+	args->interval_no = 0;
+	args->capture_drops = 0;
+	if (args->arena_cap == 0)
+		args->arena_cap = ARENA_DEFAULT_CAP;
+	arena_init(&args->interval_arena, args->arena_cap);
+	arena_init(&args->persistent_arena, args->arena_cap);
+	channel_stats_init(&args->chan_stats, &args->interval_arena);
+	frame_types_init(&args->frame_types);
+	retry_stats_init(&args->retries, &args->persistent_arena);
+	wmm_stats_init(&args->wmm);
+	response_infer_init(&args->responses);
+	tsf_util_init(&args->util, driver_profile_tsf_ref(args->state.driver.profile));
+	sampler_init(&args->sampler);
+}
+
+/**
+ * end_interval - report the current interval and start the next one.
+ * @args: user's arguments.
+ */
+static void end_interval(struct arguments *args){
+	FILE *out = args->report;
+
+	if (out == NULL)
+		goto reset;
+	fprintf(out, "interval %u: start %llu.%06llu, airtime %llu us\n",
+			args->interval_no,
+			(unsigned long long)(args->interval_start / 1000000),
+			(unsigned long long)(args->interval_start % 1000000),
+			(unsigned long long)args->interval_airtime);
+	if (args->report_hook != NULL)
+		args->report_hook(args, out);
+	if (args->frame_log != NULL && frame_log_error(args->frame_log))
+		fprintf(out, "  frame log: %s, no frame logged since\n",
+				strerror(frame_log_error(args->frame_log)));
+	if (args->interval_corrupted.frames)
+		fprintf(out, "  corrupted (bad FCS): airtime %llu us, %u frames\n",
+				(unsigned long long)args->interval_corrupted.airtime,
+				args->interval_corrupted.frames);
+	tsf_util_report(&args->util, out);
+	driver_profile_report(&args->state.driver, out);
+	response_infer_report(&args->responses, out);
+	channel_stats_report(&args->chan_stats, out);
+	frame_types_report(&args->frame_types, out);
+	wmm_stats_report(&args->wmm, out);
+	retry_stats_report(&args->retries, out);
+	fprintf(out, "  memory: interval arena %lu of %lu bytes, persistent arena %lu of %lu bytes; "
+				 "%llu allocations refused so far\n",
+			(unsigned long)args->interval_arena.used, (unsigned long)args->interval_arena.cap,
+			(unsigned long)args->persistent_arena.used, (unsigned long)args->persistent_arena.cap,
+			(unsigned long long)(args->interval_arena.overflows +
+								 args->persistent_arena.overflows));
+	fflush(out);
+
+reset:
+	channel_stats_reset(&args->chan_stats);
+	frame_types_reset(&args->frame_types);
+	retry_stats_reset(&args->retries);
+	wmm_stats_reset(&args->wmm);
+	response_infer_reset(&args->responses);
+	tsf_util_reset(&args->util);
+	arena_reset(&args->interval_arena);
+	args->interval_airtime = 0;
+	memset(&args->interval_corrupted, 0, sizeof(args->interval_corrupted));
+	args->interval_no++;
+}
+
+/**
+ * next_interval - end the report interval and start the one holding @ts.
+ * Empty intervals are skipped.
+ * @args: user's arguments.
+ * @ts: capture timestamp (us) past the interval.
+ */
+static void next_interval(struct arguments *args, u_int64_t ts){
+	args->state.interval_due = 0;
+	end_interval(args);
+	args->interval_start += (ts - args->interval_start) / args->interval * args->interval;
+}
+
+/**
+ * check_interval - close the report interval when a frame falls past it.
+ * Intervals are cut on packet timestamps. If a PPDU is open, the
+ * interval is only due: it ends when the PPDU closes, so its frames past
+ * the end stay with it.
+ * @args: user's arguments.
+ * @ts: capture timestamp (us) of the frame about to be analyzed.
+ */
+static void check_interval(struct arguments *args, u_int64_t ts){
+	if (args->interval_start == 0){
+		args->interval_start = ts;
+		return;
+	}
+	if (args->interval == 0 || ts < args->interval_start + args->interval)
+		return;
+
+	if (args->state.ampdu.open){
+		args->state.interval_due = 1;
+		args->state.due_ts = ts;
+		return;
+	}
+	next_interval(args, ts);
+}
+
+/**
+ * end_due_interval - end the report interval held open for the PPDU
+ * that just closed, if any.
+ * @args: user's arguments.
+ */
+static void end_due_interval(struct arguments *args){
+	if (args->state.interval_due)
+		next_interval(args, args->state.due_ts);
+}
+
+/**
+ * analyzer_finish - report the last interval of the capture.
+ * @args: user's arguments.
+ */
+void analyzer_finish(struct arguments *args){
+	/* the last interval holds the last PPDU in any case */
+	args->state.interval_due = 0;
+	ampdu_close(args);
+	sampler_finish(&args->sampler, args->airtime);
+	if (args->hists != NULL)
+		duration_hists_flush(args->hists);
+	response_infer_flush(&args->responses);
+	if (args->interval_start != 0)
+		end_interval(args);
+}
 
+/**
+ * analyzer_tick - close the open PPDU once its timeout has passed, for a
+ * live capture where the next frame may be long in coming. A report
+ * interval held open for it still ends with the next frame, which may
+ * fall in a later one.
+ * @args: user's arguments.
+ * @ts: capture time (us) up to which every frame has been fed.
+ */
+void analyzer_tick(struct arguments *args, u_int64_t ts){
+	const struct ampdu_acc *acc = &args->state.ampdu;
 
-	prev_frame.has_tsf_timestamp = phdr.has_tsf_timestamp;
-	prev_frame.tsf_timestamp = phdr.tsf_timestamp;
-	prev_frame.phy = phdr.phy;
-	prev_frame.phy_info = phdr.phy_info;
+	if (acc->open && ts > acc->last_ts + AMPDU_TIMEOUT)
+		ampdu_close(args);
+}
+
+/**
+ * analyzer_release - free the analyzer's memory, after analyzer_finish().
+ * @args: user's arguments.
+ */
+void analyzer_release(struct arguments *args){
+	arena_destroy(&args->interval_arena);
+	arena_destroy(&args->persistent_arena);
 }
 
 u_int8_t get_bit(u_int32_t value, u_int8_t bit){
@@ -383,7 +881,7 @@ float calculate_80211n_data_rate(u_int8_t mcs, u_int8_t bandwidth, u_int8_t shor
 		bandwidth < 0 || bandwidth > 1 || 
 		short_gi < 0 || short_gi > 1) 
 	{
-		fprintf(stderr,"invalid arguments calculate_data_rate\n");
+		pr_debug("invalid arguments calculate_data_rate\n");
 		exit(1);
 	}
 	float rates[] = {6.5, 7.2, 13.5, 15, 
@@ -427,50 +925,62 @@ float calculate_80211n_data_rate(u_int8_t mcs, u_int8_t bandwidth, u_int8_t shor
 /**
  * in_ampdu - check if this current frame is in an A-MPDU,
  * This function must only be called once for each frame.
+ * @st: analyzer state, st->prev_frame holds some previous frame info,
+ * st->current_aggregate tells if the previous frame was in an aggregate
+ * and st->driver the detector to use.
  * @phdr: physical header info
- * @prev_frame: static variable from packet_analyzer.h, some previous frame info.
- * @current_aggregate: static variable from paket_analyzer.h, if this frame is in the current aggregate.
- * @is_first_frame: static variable from packet_analyzer.h, check if this frame is the first captured frame.
  *
  * Return: 1 if it is in an A-MPDU
  */
 
-static u_int8_t in_ampdu(const struct ieee_802_11_phdr *phdr){
-	fprintf(stderr, ".....in_ampdu functino.............\n");
-
-    /* A-MPDU / aggregate detection
-     * Different generators need different detection algorithms
-     * One common pattern is to report all subframes in the aggregate with the same
-     * tsf, referenced to the start of the AMPDU (Broadcom). Another pattern is to
-     * report the tsf on the first subframe, then tsf=0 for the rest of the subframes
-     * (Intel).
-     * Another pattern is to report TSF = -1 for all frames but the last, and the
-     * last has the tsf referenced to the end of the PPDU. (QCA)
-     */
-	if ((phdr->phy == PHDR_802_11_PHY_11N || phdr->phy == PHDR_802_11_PHY_11AC) &&
-        phdr->phy == prev_frame.phy &&
-        phdr->has_tsf_timestamp && prev_frame.has_tsf_timestamp &&
-		(phdr->tsf_timestamp == prev_frame.tsf_timestamp || /* find matching TSFs */
-         (!current_aggregate && prev_frame.tsf_timestamp && phdr->tsf_timestamp == 0) || /* Intel detect second frame */
-         (prev_frame.tsf_timestamp == MAXUINT64) /* QCA, detect last frame */
-        )){
-		
-		fprintf(stderr, "This is a part of the AMPDU\n");
-		if (!current_aggregate){
-			/* This is the second subframe in a aggregate */
-			is_second_subframe = 1;
-			fprintf(stderr, "This is the second A-MPDU subframe\n");
-		}	
-		else
-			is_second_subframe = 0;
-
-		current_aggregate = 1;
+static u_int8_t in_ampdu(struct analyzer_state *st, const struct ieee_802_11_phdr *phdr){
+	const struct previous_frame_info *prev = &st->prev_frame;
+	u_int8_t match;
+
+	pr_debug(".....in_ampdu functino.............\n");
+
+	if ((phdr->phy != PHDR_802_11_PHY_11N && phdr->phy != PHDR_802_11_PHY_11AC) ||
+		phdr->phy != prev->phy ||
+		!phdr->has_tsf_timestamp || !prev->has_tsf_timestamp)
+		match = 0;
+	else {
+		/* A-MPDU / aggregate detection, by the driver's convention
+		 * (see driver_profile.h) */
+		switch (st->driver.profile){
+			case AIRTIME_DRIVER_BROADCOM:
+				/* same TSF, referenced to the start of the A-MPDU */
+				match = phdr->tsf_timestamp == prev->tsf_timestamp;
+				break;
+			case AIRTIME_DRIVER_INTEL:
+				/* TSF on the first subframe, then 0 */
+				match = phdr->tsf_timestamp == 0 &&
+						(st->current_aggregate || prev->tsf_timestamp != 0);
+				break;
+			case AIRTIME_DRIVER_QCA:
+				/* TSF = -1 for all frames but the last */
+				match = prev->tsf_timestamp == MAXUINT64;
+				break;
+			default:
+				/* still probing, or no pattern seen: all of them */
+				match = phdr->tsf_timestamp == prev->tsf_timestamp ||
+						(!st->current_aggregate && prev->tsf_timestamp &&
+						 phdr->tsf_timestamp == 0) ||
+						prev->tsf_timestamp == MAXUINT64;
+				break;
+		}
+	}
+
+	if (match){
+		pr_debug("This is a part of the AMPDU\n");
+		if (!st->current_aggregate)
+			pr_debug("This is the second A-MPDU subframe\n");
+		st->current_aggregate = 1;
 		return 1;		
 	}
-	fprintf(stderr, "This is not the part of any AMPDU\n");
-	current_aggregate = 0;
+	pr_debug("This is not the part of any AMPDU\n");
+	st->current_aggregate = 0;
 
-	fprintf(stderr, "....................................\n");
+	pr_debug("....................................\n");
 
 	return 0;
 }
@@ -1,52 +1,131 @@
 #ifndef _PACKET_ANALYZER_H
 #define _PACKET_ANALYZER_H
 
-#include <pcap.h>
+#include <stdio.h>
+#include "libairtime.h"
 #include "ieee80211.h"
+#include "radiotap_view.h"
+#include "frame_log.h"
+#include "channel_stats.h"
+#include "duration_hist.h"
+#include "sampler.h"
+#include "frame_types.h"
+#include "retry_stats.h"
+#include "wmm_stats.h"
+#include "response_infer.h"
+#include "tsf_util.h"
+#include "driver_profile.h"
+#include "arena.h"
 
-struct A_MPDU_radiotap_header {
-	u_int32_t reference_num;
-	u_int16_t flags;
-	u_int8_t delimiter_crc;
-	u_int8_t reserved;
+/* previous frame details, for aggregate detection */
+struct previous_frame_info {
+	u_int8_t has_tsf_timestamp:1;
+	u_int64_t tsf_timestamp;
+	unsigned int phy;
+	union ieee_802_11_phy_info phy_info;
+	//struct wlan_radio *radio_info;
 };
 
-struct channel_radiotap_header {
-	u_int16_t frequency;	//channel frequency
-	u_int16_t flags;		//channel flags
+#define AMPDU_MAX_LEN_HT 65535	/* longest HT A-MPDU (bytes) */
+#define AMPDU_MAX_FRAMES 64		/* subframes of an HT A-MPDU, a BlockAck window */
+#define AMPDU_TIMEOUT    10000	/* us of capture time, an open PPDU with no
+								   subframe for this long lost its tail */
+
+/* subframe of the PPDU being received, as it was accounted */
+struct ampdu_frame {
+	u_int32_t length;		/* MPDU length, including FCS */
+	u_int8_t in_aggregate;
+	u_int8_t bad_fcs;
+	u_int8_t retry;			/* retry_stats_account() flags */
+	u_int8_t ac;			/* AC_* */
+	int type;				/* FRAME_TYPE_INDEX() or FRAME_TYPE_UNKNOWN */
+	struct frame_log_record rec;	/* if there is a frame log */
 };
 
-struct MCS_radiotap_header {
-	u_int8_t known;			//Known MCS information
-	u_int8_t flags;			//MCS flags
-	u_int8_t mcs;			//MCS index
+/*
+ * HT PPDU being received. Its frames are accounted as they come with no
+ * airtime; the PSDU length is summed (subframe, delimiter, padding) and
+ * the PPDU is costed once, when it closes: at its last subframe if the
+ * driver tells which one it is, else when a frame of another PPDU comes
+ * or the timeout passes. A report interval ending inside the PPDU is
+ * held open until it closes, so it is charged whole to the interval it
+ * started in. The duration is then
+ * split across the subframes by their share of the PSDU bytes, and
+ * each share charged as its subframe was accounted: type, AC, retry,
+ * corrupted. The subframes of an A-MPDU share the RA, the TA and the
+ * channel. Histograms and the frame log get the subframes at the close.
+ */
+struct ampdu_acc {
+	u_int8_t open;
+	struct ieee_802_11_phdr phdr;	/* PHY of the first frame */
+	u_int32_t length;		/* subframes so far, each with delimiter and padding */
+	u_int8_t last_pad;		/* padding of the last subframe */
+	u_int16_t frames;
+	u_int64_t last_ts;		/* capture timestamp (us) of the last frame */
+	struct ampdu_frame frame[AMPDU_MAX_FRAMES];
 };
 
-struct arguments{
-	pcap_dumper_t *dumper;
-	unsigned int airtime;
+/* state carried from one frame to the next */
+struct analyzer_state {
+	struct previous_frame_info prev_frame;
+	u_int8_t current_aggregate;	/* previous frame is in an aggregate */
+	u_int8_t is_first_frame;	/* use to identify the first captured frame */
+	struct ampdu_acc ampdu;		/* PPDU not costed yet */
+	u_int8_t interval_due;		/* the report interval ended inside it */
+	u_int64_t due_ts;			/* last frame past the interval (us) */
+	unsigned int pkt_no;		/* packet number */
+	struct driver_profile driver;	/* A-MPDU timestamp convention */
 };
 
+struct arguments{
+	struct frame_log *frame_log;	/* columnar per-frame output, optional */
+	struct duration_hists *hists;	/* duration and size histograms, optional */
+	FILE *report;					/* interval reports, NULL = none */
+	u_int64_t interval;				/* report interval (us), 0 = whole capture */
+	size_t arena_cap;				/* bytes per arena, 0 = ARENA_DEFAULT_CAP */
+	u_int8_t driver;				/* AIRTIME_DRIVER_*, AUTO = detect */
+	/* called at the top of each interval report, the capture side
+	 * reports its drops there */
+	void (*report_hook)(struct arguments *args, FILE *out);
+	void *hook_ctx;
 
-/* previous frame details, for aggregate detection */
-struct previous_frame_info {
-	u_int8_t has_tsf_timestamp:1;
-	u_int64_t tsf_timestamp;
-	unsigned int phy;
-	union ieee_802_11_phy_info phy_info;
-	unsigned int prev_length; 
-	//struct wlan_radio *radio_info;
-	unsigned int duration;
+	struct sampler sampler;			/* PPDU sampling, off by default */
+
+	struct analyzer_state state;
+	struct arena interval_arena;	/* tables of the current interval */
+	struct arena persistent_arena;	/* tables kept for the whole capture */
+	u_int64_t airtime;				/* of the analyzed frames */
+	u_int64_t corrupted_airtime;	/* part of it spent on bad-FCS frames */
+
+	/* current report interval */
+	u_int64_t interval_start;		/* capture timestamp (us), 0 before the first frame */
+	unsigned int interval_no;
+	u_int64_t interval_airtime;
+	struct airtime_counter interval_corrupted;	/* bad-FCS frames */
+	struct channel_stats chan_stats;
+	struct frame_type_stats frame_types;
+	struct wmm_stats wmm;
+	struct retry_stats retries;		/* stations are kept across intervals */
+	struct response_infer responses;	/* missed control responses */
+	struct tsf_util util;			/* busy time by TSF, kept across intervals */
+
+	u_int64_t capture_drops;		/* frames lost so far, by the capture side */
 };
 
-void got_packet(u_char *args, const struct pcap_pkthdr *header, const u_char *packet);
+void analyzer_init(struct arguments *args);
+
+void analyzer_finish(struct arguments *args);
+
+void analyzer_tick(struct arguments *args, u_int64_t ts);
+
+void analyzer_release(struct arguments *args);
+
+int analyzer_feed(struct arguments *args, const struct airtime_frame *f);
 
 u_int8_t get_bit(u_int32_t value, u_int8_t bit);
 
 u_int8_t get_sub_value(u_int32_t value, u_int32_t mask);
 
 
-static u_int8_t in_ampdu(const struct ieee_802_11_phdr *phdr);
-
 
 #endif
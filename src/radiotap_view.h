@@ -0,0 +1,137 @@
+#ifndef _RADIOTAP_VIEW_H
+#define _RADIOTAP_VIEW_H
+
+#include <stddef.h>
+#include <sys/types.h>
+#include "le_byteshift.h"
+
+/*
+ * Zero-copy views of radiotap arguments.
+ * ieee80211_radiotap_iterator_next() hands out iter.this_arg, which is
+ * only aligned relative to the start of the radiotap header, and the
+ * header itself may sit anywhere in the capture buffer. The structs
+ * below only describe the field layout; the accessors never dereference
+ * them, they read each field with an unaligned-safe little endian load
+ * (a single load on x86, byte loads on strict-alignment targets).
+ */
+
+struct A_MPDU_radiotap_header {
+	u_int32_t reference_num;
+	u_int16_t flags;
+	u_int8_t delimiter_crc;
+	u_int8_t reserved;
+} __attribute__((packed));
+
+struct channel_radiotap_header {
+	u_int16_t frequency;	//channel frequency
+	u_int16_t flags;		//channel flags
+} __attribute__((packed));
+
+struct MCS_radiotap_header {
+	u_int8_t known;			//Known MCS information
+	u_int8_t flags;			//MCS flags
+	u_int8_t mcs;			//MCS index
+} __attribute__((packed));
+
+struct rtap_channel_view { const u_int8_t *p; };
+struct rtap_ampdu_view { const u_int8_t *p; };
+struct rtap_mcs_view { const u_int8_t *p; };
+struct rtap_tsft_view { const u_int8_t *p; };
+
+#define RTAP_FIELD(view, type, field) ((view).p + offsetof(type, field))
+
+/* IEEE80211_RADIOTAP_CHANNEL */
+static inline struct rtap_channel_view rtap_channel(const void *arg){
+	return (struct rtap_channel_view){ .p = arg };
+}
+
+static inline u_int16_t rtap_channel_frequency(struct rtap_channel_view v){
+	return get_unaligned_le16(RTAP_FIELD(v, struct channel_radiotap_header, frequency));
+}
+
+static inline u_int16_t rtap_channel_flags(struct rtap_channel_view v){
+	return get_unaligned_le16(RTAP_FIELD(v, struct channel_radiotap_header, flags));
+}
+
+/* IEEE80211_RADIOTAP_AMPDU_STATUS */
+static inline struct rtap_ampdu_view rtap_ampdu(const void *arg){
+	return (struct rtap_ampdu_view){ .p = arg };
+}
+
+static inline u_int32_t rtap_ampdu_reference(struct rtap_ampdu_view v){
+	return get_unaligned_le32(RTAP_FIELD(v, struct A_MPDU_radiotap_header, reference_num));
+}
+
+static inline u_int16_t rtap_ampdu_flags(struct rtap_ampdu_view v){
+	return get_unaligned_le16(RTAP_FIELD(v, struct A_MPDU_radiotap_header, flags));
+}
+
+static inline u_int8_t rtap_ampdu_delimiter_crc(struct rtap_ampdu_view v){
+	return *RTAP_FIELD(v, struct A_MPDU_radiotap_header, delimiter_crc);
+}
+
+/* IEEE80211_RADIOTAP_MCS */
+static inline struct rtap_mcs_view rtap_mcs(const void *arg){
+	return (struct rtap_mcs_view){ .p = arg };
+}
+
+static inline u_int8_t rtap_mcs_known(struct rtap_mcs_view v){
+	return *RTAP_FIELD(v, struct MCS_radiotap_header, known);
+}
+
+static inline u_int8_t rtap_mcs_flags(struct rtap_mcs_view v){
+	return *RTAP_FIELD(v, struct MCS_radiotap_header, flags);
+}
+
+static inline u_int8_t rtap_mcs_index(struct rtap_mcs_view v){
+	return *RTAP_FIELD(v, struct MCS_radiotap_header, mcs);
+}
+
+/* IEEE80211_RADIOTAP_TSFT */
+static inline struct rtap_tsft_view rtap_tsft(const void *arg){
+	return (struct rtap_tsft_view){ .p = arg };
+}
+
+static inline u_int64_t rtap_tsft_value(struct rtap_tsft_view v){
+	return get_unaligned_le64(v.p);
+}
+
+/**
+ * rtap_peek_tsft - read the TSFT field without iterating the header.
+ * TSFT is bit 0 of the first present word, so when present it is the
+ * first field, 8 byte aligned after the (possibly extended) bitmaps.
+ * @rtap: radiotap header.
+ * @caplen: captured bytes from @rtap.
+ * @tsf: TSF value, set if present.
+ *
+ * Return: 1 if the frame carries a TSFT field, 0 otherwise.
+ */
+static inline int rtap_peek_tsft(const u_int8_t *rtap, unsigned int caplen, u_int64_t *tsf){
+	unsigned int offset = 4;
+	u_int32_t present;
+
+	if (caplen < 8)
+		return 0;
+	present = get_unaligned_le32(rtap + 4);
+	if (!(present & 1))
+		return 0;
+	do {
+		if (offset + 4 > caplen)
+			return 0;
+		present = get_unaligned_le32(rtap + offset);
+		offset += 4;
+	} while (present & 0x80000000);
+
+	offset = (offset + 7) & ~7u;
+	if (offset + 8 > caplen || offset + 8 > get_unaligned_le16(rtap + 2))
+		return 0;
+	*tsf = get_unaligned_le64(rtap + offset);
+	return 1;
+}
+
+/* IEEE80211_RADIOTAP_FLAGS and IEEE80211_RADIOTAP_RATE are single bytes */
+static inline u_int8_t rtap_u8(const void *arg){
+	return *(const u_int8_t*)arg;
+}
+
+#endif
@@ -0,0 +1,286 @@
+#include <string.h>
+#include "response_infer.h"
+#include "mac_header.h"
+
+#define TSF_INVALID 0xffffffffffffffffULL	/* QCA, until the last subframe */
+
+const char *resp_names[RESP_KINDS] = { "none", "ACK", "CTS", "BlockAck" };
+
+/*
+ * Response durations (us), as calculate_duration() costs them:
+ * ACK and CTS are 14 bytes, a compressed BlockAck 32 bytes.
+ * DSSS: preamble (192 or 96 us) + ceil(8 * length / rate),
+ * OFDM: 20 us + 4 us * ceil((16 + 8 * length + 6) / (4 * rate)).
+ */
+const u_int16_t resp_duration[RESP_KINDS][RESP_RATES] = {
+	/*                  1    2  5.5   11  2s 5.5s 11s   6  12  24 */
+	[RESP_NONE]      = {   0,   0,   0,   0,   0,   0,   0,  0,  0,  0 },
+	[RESP_ACK]       = { 304, 248, 213, 203, 152, 117, 107, 44, 32, 28 },
+	[RESP_CTS]       = { 304, 248, 213, 203, 152, 117, 107, 44, 32, 28 },
+	[RESP_BLOCK_ACK] = { 448, 320, 239, 216, 224, 143, 120, 68, 44, 32 },
+};
+
+/**
+ * response_rate - rate of the response to a frame.
+ * DSSS rates are all mandatory, so the response goes at the rate of
+ * the frame; OFDM and HT frames are answered at 6, 12 or 24 Mb/s, HT by
+ * the modulation of the MCS.
+ * @phdr: physical header info of the eliciting frame.
+ *
+ * Return: RESP_RATE_*, -1 if the PHY is not handled.
+ */
+static int response_rate(const struct ieee_802_11_phdr *phdr){
+	u_int8_t rate = phdr->has_data_rate ? phdr->data_rate : 2;
+
+	switch (phdr->phy){
+		case PHDR_802_11_PHY_11B:
+		{
+			int short_preamble = phdr->phy_info.info_11b.has_short_preamble &&
+								 phdr->phy_info.info_11b.short_preamble;
+			if (rate >= 22)
+				return short_preamble ? RESP_RATE_11M_SHORT : RESP_RATE_11M;
+			if (rate >= 11)
+				return short_preamble ? RESP_RATE_5_5M_SHORT : RESP_RATE_5_5M;
+			if (rate >= 4)
+				return short_preamble ? RESP_RATE_2M_SHORT : RESP_RATE_2M;
+			return RESP_RATE_1M;
+		}
+		case PHDR_802_11_PHY_11A:
+		case PHDR_802_11_PHY_11G:
+			if (rate >= 48)
+				return RESP_RATE_24M;
+			if (rate >= 24)
+				return RESP_RATE_12M;
+			return RESP_RATE_6M;
+		case PHDR_802_11_PHY_11N:
+		{
+			const struct ieee_802_11n *_n = &phdr->phy_info.info_11n;
+			if (!_n->has_mcs_index || _n->mcs_index >= 32)
+				return RESP_RATE_6M;
+			switch (_n->mcs_index % 8){
+				case 0:
+					return RESP_RATE_6M;	/* BPSK */
+				case 1:
+				case 2:
+					return RESP_RATE_12M;	/* QPSK */
+				default:
+					return RESP_RATE_24M;	/* 16-QAM and up */
+			}
+		}
+	}
+	return -1;
+}
+
+/**
+ * expected_response - response a frame elicits.
+ * @mac: MAC header.
+ * @mac_caplen: captured bytes from @mac.
+ * @in_aggregate: equal 1 if the frame is an A-MPDU subframe.
+ *
+ * Return: RESP_*.
+ */
+static int expected_response(const u_int8_t *mac, unsigned int mac_caplen,
+							 u_int8_t in_aggregate){
+	const u_int8_t *ra = mac_ra(mac, mac_caplen);
+	u_int16_t fc;
+
+	if (ra == NULL || (ra[0] & 0x01))
+		return RESP_NONE;
+	fc = mac_frame_control(mac);
+
+	switch (mac_fc_type(fc)){
+		case IEEE80211_FTYPE_MGMT:
+			if (mac_fc_subtype(fc) == IEEE80211_STYPE_ACTION_NOACK)
+				return RESP_NONE;
+			return RESP_ACK;
+		case IEEE80211_FTYPE_CTL:
+			switch (mac_fc_subtype(fc)){
+				case IEEE80211_STYPE_RTS:
+					return RESP_CTS;
+				case IEEE80211_STYPE_BACK_REQ:
+					return RESP_BLOCK_ACK;
+				case IEEE80211_STYPE_PSPOLL:
+					return RESP_ACK;
+			}
+			return RESP_NONE;
+		case IEEE80211_FTYPE_DATA:
+			switch (mac_qos_ack_policy(mac, mac_caplen)){
+				case IEEE80211_QOS_ACK_NONE:
+				case IEEE80211_QOS_ACK_PSMP:
+				case IEEE80211_QOS_ACK_BLOCK:
+					return RESP_NONE;
+			}
+			return in_aggregate ? RESP_BLOCK_ACK : RESP_ACK;
+	}
+	return RESP_NONE;
+}
+
+/**
+ * response_kind - response a captured frame is.
+ * @mac: MAC header.
+ * @mac_caplen: captured bytes from @mac.
+ *
+ * Return: RESP_*, RESP_NONE if it is not a control response.
+ */
+static int response_kind(const u_int8_t *mac, unsigned int mac_caplen){
+	u_int16_t fc;
+
+	if (mac_caplen < 2)
+		return RESP_NONE;
+	fc = mac_frame_control(mac);
+	if (mac_fc_type(fc) != IEEE80211_FTYPE_CTL)
+		return RESP_NONE;
+	switch (mac_fc_subtype(fc)){
+		case IEEE80211_STYPE_ACK:
+			return RESP_ACK;
+		case IEEE80211_STYPE_CTS:
+			return RESP_CTS;
+		case IEEE80211_STYPE_BACK:
+			return RESP_BLOCK_ACK;
+	}
+	return RESP_NONE;
+}
+
+static inline int tsf_valid(const struct ieee_802_11_phdr *phdr){
+	return phdr->has_tsf_timestamp && phdr->tsf_timestamp != 0 &&
+		   phdr->tsf_timestamp != TSF_INVALID;
+}
+
+/**
+ * response_infer_init - clear the counters and the expectation.
+ * @ri: response inference.
+ */
+void response_infer_init(struct response_infer *ri){
+	memset(ri, 0, sizeof(*ri));
+}
+
+/**
+ * response_infer_flush - count the expected response as missed.
+ * @ri: response inference.
+ */
+void response_infer_flush(struct response_infer *ri){
+	u_int16_t duration;
+
+	if (ri->pending == RESP_NONE)
+		return;
+	duration = resp_duration[ri->pending][ri->rate];
+	ri->inferred[ri->pending].airtime += duration;
+	ri->inferred[ri->pending].frames++;
+	ri->total_inferred_airtime += duration;
+	ri->total_inferred++;
+	ri->pending = RESP_NONE;
+}
+
+/**
+ * is_response - check whether a frame answers the pending expectation.
+ * A frame whose MAC header was not captured (or not trusted) is taken
+ * as the response when it falls in the window.
+ * @ri: response inference.
+ * @mac: MAC header.
+ * @mac_caplen: captured bytes from @mac.
+ * @phdr: physical header info.
+ *
+ * Return: 1 if it is the response.
+ */
+static int is_response(const struct response_infer *ri, const u_int8_t *mac,
+					   unsigned int mac_caplen,
+					   const struct ieee_802_11_phdr *phdr){
+	const u_int8_t *ra;
+
+	if (ri->has_tsf && tsf_valid(phdr) && phdr->tsf_timestamp > ri->tsf &&
+		phdr->tsf_timestamp - ri->tsf > ri->ppdu_airtime + ri->sifs +
+		resp_duration[ri->pending][ri->rate] + RESP_TOLERANCE)
+		return 0;
+	if (mac_caplen < 2)
+		return 1;
+	if (response_kind(mac, mac_caplen) != ri->pending)
+		return 0;
+	ra = mac_ra(mac, mac_caplen);
+	return !ri->has_ta || ra == NULL || memcmp(ra, ri->ta, MAC_ADDR_LEN) == 0;
+}
+
+/**
+ * response_infer_frame - match a frame against the pending expectation,
+ * then arm the one it elicits.
+ * @ri: response inference.
+ * @mac: MAC header.
+ * @mac_caplen: captured bytes from @mac, 0 if the header is not trusted.
+ * @phdr: physical header info.
+ * @in_aggregate: equal 1 if the frame continues the previous PPDU.
+ * @airtime: airtime of the frame.
+ */
+void response_infer_frame(struct response_infer *ri, const u_int8_t *mac,
+						  unsigned int mac_caplen,
+						  const struct ieee_802_11_phdr *phdr,
+						  u_int8_t in_aggregate, int airtime){
+	int kind, rate;
+
+	if (in_aggregate){
+		/* one more subframe of the armed PPDU: the answer is a BlockAck
+		 * if any subframe asks for one */
+		if (expected_response(mac, mac_caplen, 1) == RESP_BLOCK_ACK &&
+			ri->pending != RESP_NONE)
+			ri->pending = RESP_BLOCK_ACK;
+		ri->ppdu_airtime += airtime;
+		if (!ri->has_tsf && tsf_valid(phdr)){
+			ri->has_tsf = 1;
+			ri->tsf = phdr->tsf_timestamp;
+		}
+		return;
+	}
+
+	if (ri->pending != RESP_NONE){
+		if (is_response(ri, mac, mac_caplen, phdr)){
+			ri->captured++;
+			ri->pending = RESP_NONE;
+			return;
+		}
+		response_infer_flush(ri);
+	}
+
+	if (mac_caplen < 2 || (kind = expected_response(mac, mac_caplen, 0)) == RESP_NONE)
+		return;
+	if ((rate = response_rate(phdr)) < 0)
+		return;
+
+	ri->pending = kind;
+	ri->rate = rate;
+	ri->has_ta = mac_ta(mac, mac_caplen) != NULL;
+	if (ri->has_ta)
+		memcpy(ri->ta, mac_ta(mac, mac_caplen), MAC_ADDR_LEN);
+	ri->has_tsf = tsf_valid(phdr);
+	ri->tsf = phdr->tsf_timestamp;
+	ri->ppdu_airtime = airtime;
+	/* 10 us in 2.4 GHz, 16 us for OFDM in 5 GHz */
+	ri->sifs = phdr->has_frequency && phdr->frequency > 4000 ? 16 : 10;
+}
+
+/**
+ * response_infer_report - print the inferred responses of the interval.
+ * @ri: response inference.
+ * @out: report stream.
+ */
+void response_infer_report(const struct response_infer *ri, FILE *out){
+	u_int64_t airtime = 0;
+	int i;
+
+	for (i = RESP_ACK; i < RESP_KINDS; i++)
+		airtime += ri->inferred[i].airtime;
+	fprintf(out, "  inferred responses (not in the total): airtime %llu us; "
+				 "%s %u, %s %u, %s %u; %u expected responses captured\n",
+			(unsigned long long)airtime,
+			resp_names[RESP_ACK], ri->inferred[RESP_ACK].frames,
+			resp_names[RESP_CTS], ri->inferred[RESP_CTS].frames,
+			resp_names[RESP_BLOCK_ACK], ri->inferred[RESP_BLOCK_ACK].frames,
+			ri->captured);
+}
+
+/**
+ * response_infer_reset - start a new interval.
+ * The expectation is kept, its outcome belongs to the next interval.
+ * @ri: response inference.
+ */
+void response_infer_reset(struct response_infer *ri){
+	memset(ri->inferred, 0, sizeof(ri->inferred));
+	ri->captured = 0;
+}
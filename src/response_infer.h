@@ -0,0 +1,97 @@
+#ifndef _RESPONSE_INFER_H
+#define _RESPONSE_INFER_H
+
+#include <stdio.h>
+#include <sys/types.h>
+#include "ieee80211.h"
+#include "channel_stats.h"
+
+/* control responses */
+#define RESP_NONE      0
+#define RESP_ACK       1
+#define RESP_CTS       2
+#define RESP_BLOCK_ACK 3	/* compressed BlockAck */
+#define RESP_KINDS     4
+
+/* rates a control response is sent at: the highest mandatory rate not
+ * above the rate of the eliciting frame */
+#define RESP_RATE_1M        0	/* DSSS, long preamble */
+#define RESP_RATE_2M        1
+#define RESP_RATE_5_5M      2
+#define RESP_RATE_11M       3
+#define RESP_RATE_2M_SHORT  4	/* DSSS, short preamble */
+#define RESP_RATE_5_5M_SHORT 5
+#define RESP_RATE_11M_SHORT 6
+#define RESP_RATE_6M        7	/* OFDM */
+#define RESP_RATE_12M       8
+#define RESP_RATE_24M       9
+#define RESP_RATES          10
+
+#define RESP_TOLERANCE 16	/* us, TSF jitter and PPDU start/end conventions */
+
+extern const char *resp_names[RESP_KINDS];
+extern const u_int16_t resp_duration[RESP_KINDS][RESP_RATES];
+
+/*
+ * Inference of control responses the monitor radio did not capture.
+ * Each unicast frame that elicits a response (ACK, CTS after RTS,
+ * BlockAck after an A-MPDU or a BlockAckReq) arms an expectation. The
+ * next captured PPDU either is that response, addressed to the
+ * transmitter of the frame and starting within SIFS plus RESP_TOLERANCE
+ * of its end (by TSF), or the response is taken as missed and its
+ * duration, looked up in resp_duration, is counted as inferred airtime.
+ * Inferred airtime is kept apart and never added to the total.
+ */
+struct response_infer {
+	/* the response the last PPDU is waiting for */
+	u_int8_t pending;			/* RESP_* */
+	u_int8_t rate;				/* RESP_RATE_* */
+	u_int8_t has_ta;
+	u_int8_t ta[6];				/* receiver of the response */
+	u_int8_t has_tsf;
+	u_int64_t tsf;				/* first valid TSF of the PPDU */
+	u_int32_t ppdu_airtime;
+	u_int8_t sifs;
+
+	/* this interval */
+	struct airtime_counter inferred[RESP_KINDS];
+	u_int32_t captured;			/* expected responses that were captured */
+
+	/* whole capture */
+	u_int64_t total_inferred_airtime;
+	u_int64_t total_inferred;
+};
+
+void response_infer_init(struct response_infer *ri);
+
+void response_infer_frame(struct response_infer *ri, const u_int8_t *mac,
+						  unsigned int mac_caplen,
+						  const struct ieee_802_11_phdr *phdr,
+						  u_int8_t in_aggregate, int airtime);
+
+void response_infer_flush(struct response_infer *ri);
+
+/**
+ * response_infer_adjust - change the airtime of the last frame, in the
+ * PPDU it belongs to.
+ * @ri: response inference.
+ * @adjust: airtime to add.
+ */
+static inline void response_infer_adjust(struct response_infer *ri, int adjust){
+	ri->ppdu_airtime += adjust;
+}
+
+/**
+ * response_infer_forget - drop the expectation without inferring, when
+ * the frames that follow are not analyzed.
+ * @ri: response inference.
+ */
+static inline void response_infer_forget(struct response_infer *ri){
+	ri->pending = RESP_NONE;
+}
+
+void response_infer_report(const struct response_infer *ri, FILE *out);
+
+void response_infer_reset(struct response_infer *ri);
+
+#endif
@@ -0,0 +1,286 @@
+#include <string.h>
+#include "retry_stats.h"
+
+/* ring entry of an MPDU; never 0, 0 marks a free slot */
+#define RETRY_KEY(tid, seq_ctrl) (0x80000000u | ((u_int32_t)((tid) & 0x1f) << 16) | (seq_ctrl))
+#define TID_NONE 16	/* non-QoS frames share one sequence space */
+
+static unsigned int station_hash(const u_int8_t *addr){
+	return (addr[3] * 31 + addr[4] * 7 + addr[5]) % STATION_HASH_SIZE;
+}
+
+static inline void count(struct airtime_counter *c, int duration){
+	c->airtime += duration;
+	c->frames++;
+}
+
+/**
+ * retry_stats_init - forget every station and clear the counters.
+ * @rs: retry stats.
+ * @arena: persistent arena for the stations, NULL tracks none.
+ */
+void retry_stats_init(struct retry_stats *rs, struct arena *arena){
+	memset(rs, 0, sizeof(*rs));
+	rs->stations_tail = &rs->stations;
+	rs->arena = arena;
+}
+
+/**
+ * find_station - look up a transmitter, adding it if the arena has room.
+ * @rs: retry stats.
+ * @addr: transmitter address.
+ *
+ * Return: the station, NULL if it could not be added.
+ */
+static struct station_entry *find_station(struct retry_stats *rs, const u_int8_t *addr){
+	unsigned int h = station_hash(addr);
+	struct station_entry *e;
+
+	for (e = rs->index[h]; e != NULL; e = e->next)
+		if (memcmp(e->addr, addr, 6) == 0)
+			return e;
+
+	if (rs->free != NULL){
+		e = rs->free;
+		rs->free = e->list;
+		memset(e, 0, sizeof(*e));
+	} else {
+		e = arena_alloc(rs->arena, sizeof(*e));
+		if (e == NULL)
+			return NULL;
+	}
+	memcpy(e->addr, addr, 6);
+	e->next = rs->index[h];
+	rs->index[h] = e;
+	*rs->stations_tail = e;
+	rs->stations_tail = &e->list;
+	rs->n_stations++;
+	return e;
+}
+
+/**
+ * seen_recently - check the station's window for an MPDU, and remember it.
+ * @e: station.
+ * @key: RETRY_KEY() of the MPDU.
+ *
+ * Return: 1 if it is in the window.
+ */
+static int seen_recently(struct station_entry *e, u_int32_t key){
+	unsigned int i;
+
+	for (i = 0; i < SEQ_RING_SIZE; i++)
+		if (e->ring[i] == key)
+			return 1;
+	e->ring[e->ring_head] = key;
+	e->ring_head = (e->ring_head + 1) % SEQ_RING_SIZE;
+	return 0;
+}
+
+/**
+ * retry_stats_account - classify a frame as a first transmission or a
+ * retry and charge its airtime, and charge the transmitter per AC.
+ * @rs: retry stats.
+ * @ta: transmitter address, NULL if none.
+ * @has_seq: equal 1 if @seq_ctrl is valid.
+ * @seq_ctrl: Sequence Control field.
+ * @tid: QoS TID, -1 for non-QoS frames.
+ * @retry_bit: Retry bit of Frame Control.
+ * @duration: airtime of the frame.
+ *
+ * Return: RETRY_STATS_* flags of the frame.
+ */
+int retry_stats_account(struct retry_stats *rs, const u_int8_t *ta,
+						int has_seq, u_int16_t seq_ctrl, int tid,
+						u_int8_t retry_bit, int duration){
+	struct station_entry *station = NULL;
+	u_int8_t retry = 0;
+
+	/* without a sequence number there is nothing to retransmit */
+	if (ta != NULL && has_seq){
+		station = find_station(rs, ta);
+		retry = retry_bit;
+		if (station != NULL &&
+			seen_recently(station,
+						  RETRY_KEY(tid < 0 ? TID_NONE : tid, seq_ctrl))){
+			retry = 1;
+			rs->duplicates++;
+		}
+	}
+
+	count(retry ? &rs->retry : &rs->useful, duration);
+	if (station == NULL)
+		return retry ? RETRY_STATS_RETRY : 0;
+
+	count(retry ? &station->retry : &station->useful, duration);
+	count(&station->ac[tid_to_ac(tid)], duration);
+	rs->last_station = station;
+	return (retry ? RETRY_STATS_RETRY : 0) | RETRY_STATS_STATION;
+}
+
+/**
+ * retry_stats_adjust - change the airtime of a frame already accounted,
+ * charged as the frame was. A frame charged to its transmitter must be
+ * the last one charged to a transmitter, or from the same one: the
+ * subframes of an A-MPDU.
+ * @rs: retry stats.
+ * @flags: retry_stats_account() result of the frame.
+ * @ac: AC_* of the frame.
+ * @adjust: airtime to add.
+ */
+void retry_stats_adjust(struct retry_stats *rs, int flags, int ac, int adjust){
+	u_int8_t retry = (flags & RETRY_STATS_RETRY) != 0;
+
+	if ((flags & RETRY_STATS_STATION) && rs->last_station != NULL){
+		struct station_entry *e = rs->last_station;
+		(retry ? &e->retry : &e->useful)->airtime += adjust;
+		e->ac[ac].airtime += adjust;
+	}
+	(retry ? &rs->retry : &rs->useful)->airtime += adjust;
+}
+
+/**
+ * retry_stats_report - print useful and retry airtime of the interval,
+ * in total and per transmitter, and the transmitters' airtime per AC.
+ * @rs: retry stats.
+ * @out: report stream.
+ */
+void retry_stats_report(const struct retry_stats *rs, FILE *out){
+	u_int64_t total = rs->useful.airtime + rs->retry.airtime;
+	const struct station_entry *e;
+
+	fprintf(out, "  useful airtime %llu us, %u frames; retry airtime %llu us (%.1f%%), "
+				 "%u frames, %u repeating a captured MPDU\n",
+			(unsigned long long)rs->useful.airtime, rs->useful.frames,
+			(unsigned long long)rs->retry.airtime,
+			total ? 100.0 * rs->retry.airtime / total : 0.0, rs->retry.frames,
+			rs->duplicates);
+
+	for (e = rs->stations; e != NULL; e = e->list){
+		if (e->useful.frames + e->retry.frames == 0)
+			continue;
+		fprintf(out, "  station %02x:%02x:%02x:%02x:%02x:%02x: useful %llu us, %u frames; "
+					 "retry %llu us, %u frames\n",
+				e->addr[0], e->addr[1], e->addr[2], e->addr[3], e->addr[4], e->addr[5],
+				(unsigned long long)e->useful.airtime, e->useful.frames,
+				(unsigned long long)e->retry.airtime, e->retry.frames);
+		fprintf(out, "    %s %llu us, %s %llu us, %s %llu us, %s %llu us, %s %llu us\n",
+				ac_names[AC_VO], (unsigned long long)e->ac[AC_VO].airtime,
+				ac_names[AC_VI], (unsigned long long)e->ac[AC_VI].airtime,
+				ac_names[AC_BE], (unsigned long long)e->ac[AC_BE].airtime,
+				ac_names[AC_BK], (unsigned long long)e->ac[AC_BK].airtime,
+				ac_names[AC_OTHER], (unsigned long long)e->ac[AC_OTHER].airtime);
+	}
+}
+
+/**
+ * retry_stats_save - write the stations, their windows and the
+ * interval's counters to a checkpoint.
+ * @rs: retry stats.
+ * @fp: checkpoint stream.
+ *
+ * Return: 0 on success, -1 on a write error.
+ */
+int retry_stats_save(const struct retry_stats *rs, FILE *fp){
+	const struct station_entry *e;
+	int32_t last = -1, i = 0;
+
+	if (fwrite(rs, sizeof(*rs), 1, fp) != 1)
+		return -1;
+	for (e = rs->stations; e != NULL; e = e->list, i++){
+		if (fwrite(e, sizeof(*e), 1, fp) != 1)
+			return -1;
+		if (e == rs->last_station)
+			last = i;
+	}
+	return fwrite(&last, sizeof(last), 1, fp) == 1 ? 0 : -1;
+}
+
+/**
+ * retry_stats_load - restore the stations and the interval's counters
+ * from a checkpoint, in their order of appearance. Stations past the
+ * arena cap are left out, they rely on the Retry bit again.
+ * @rs: retry stats, just initialized.
+ * @fp: checkpoint stream.
+ *
+ * Return: 0 on success, -1 on a short record.
+ */
+int retry_stats_load(struct retry_stats *rs, FILE *fp){
+	struct retry_stats saved;
+	struct station_entry se, *e;
+	int32_t last, i;
+
+	if (fread(&saved, sizeof(saved), 1, fp) != 1)
+		return -1;
+	rs->useful = saved.useful;
+	rs->retry = saved.retry;
+	rs->duplicates = saved.duplicates;
+
+	for (i = 0; i < (int32_t)saved.n_stations; i++){
+		if (fread(&se, sizeof(se), 1, fp) != 1)
+			return -1;
+		e = find_station(rs, se.addr);
+		if (e == NULL)
+			continue;
+		e->ring_head = se.ring_head % SEQ_RING_SIZE;
+		e->idle = se.idle;
+		memcpy(e->ring, se.ring, sizeof(e->ring));
+		e->useful = se.useful;
+		e->retry = se.retry;
+		memcpy(e->ac, se.ac, sizeof(e->ac));
+	}
+
+	if (fread(&last, sizeof(last), 1, fp) != 1)
+		return -1;
+	for (e = rs->stations, i = 0; e != NULL && i < last; e = e->list)
+		i++;
+	rs->last_station = last >= 0 ? e : NULL;
+	return 0;
+}
+
+/**
+ * drop_station - unlink a station from the index and move it to the
+ * free list.
+ * @rs: retry stats.
+ * @e: station.
+ */
+static void drop_station(struct retry_stats *rs, struct station_entry *e){
+	struct station_entry **p = &rs->index[station_hash(e->addr)];
+
+	while (*p != e)
+		p = &(*p)->next;
+	*p = e->next;
+	e->list = rs->free;
+	rs->free = e;
+	rs->n_stations--;
+	if (rs->last_station == e)
+		rs->last_station = NULL;
+}
+
+/**
+ * retry_stats_reset - start a new interval.
+ * Stations and their windows are kept, except those silent for
+ * STATION_IDLE_MAX intervals, which are dropped.
+ * @rs: retry stats.
+ */
+void retry_stats_reset(struct retry_stats *rs){
+	struct station_entry **p = &rs->stations;
+	struct station_entry *e;
+
+	while ((e = *p) != NULL){
+		if (e->useful.frames + e->retry.frames != 0)
+			e->idle = 0;
+		else if (++e->idle >= STATION_IDLE_MAX){
+			*p = e->list;
+			drop_station(rs, e);
+			continue;
+		}
+		p = &e->list;
+		memset(&e->useful, 0, sizeof(e->useful));
+		memset(&e->retry, 0, sizeof(e->retry));
+		memset(e->ac, 0, sizeof(e->ac));
+	}
+	rs->stations_tail = p;
+	memset(&rs->useful, 0, sizeof(rs->useful));
+	memset(&rs->retry, 0, sizeof(rs->retry));
+	rs->duplicates = 0;
+}
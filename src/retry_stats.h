@@ -0,0 +1,76 @@
+#ifndef _RETRY_STATS_H
+#define _RETRY_STATS_H
+
+#include <stdio.h>
+#include <sys/types.h>
+#include "channel_stats.h"
+#include "wmm_stats.h"
+#include "arena.h"
+
+#define STATION_HASH_SIZE 128	/* buckets of the transmitter index */
+#define SEQ_RING_SIZE     64	/* recent MPDUs per transmitter, one BlockAck window */
+#define STATION_IDLE_MAX  3	/* silent intervals before a station is dropped */
+
+/* retry_stats_account() result */
+#define RETRY_STATS_RETRY   0x01	/* the frame is a retry */
+#define RETRY_STATS_STATION 0x02	/* it was charged to its transmitter */
+
+struct station_entry {
+	u_int8_t addr[6];
+	u_int8_t ring_head;
+	u_int8_t idle;				/* intervals without a frame */
+	u_int32_t ring[SEQ_RING_SIZE];	/* RETRY_KEY() of recent MPDUs */
+	struct airtime_counter useful;	/* this interval */
+	struct airtime_counter retry;
+	struct airtime_counter ac[AC_COUNT];
+	struct station_entry *next;		/* same bucket */
+	struct station_entry *list;		/* next transmitter seen, or next free */
+};
+
+/*
+ * Retransmission detection.
+ * An MPDU is a retry when its Retry bit is set, or when its transmitter
+ * sent the same (TID, sequence number, fragment number) recently. The
+ * stations come from the analyzer's persistent arena and are kept
+ * across intervals, so the windows survive interval ends; only the
+ * counters are reset. A station silent for STATION_IDLE_MAX intervals
+ * is dropped and its entry reused, so randomized addresses do not fill
+ * the arena for good. Transmitters that do not fit under the arena cap
+ * rely on the Retry bit alone.
+ * The same table keeps the airtime of each transmitter per access
+ * category.
+ */
+struct retry_stats {
+	struct station_entry *index[STATION_HASH_SIZE];
+	struct station_entry *stations;	/* in order of appearance */
+	struct station_entry **stations_tail;
+	unsigned int n_stations;
+	struct station_entry *free;		/* dropped stations, for reuse */
+	struct arena *arena;			/* persistent arena of the stations */
+
+	/* this interval */
+	struct airtime_counter useful;
+	struct airtime_counter retry;
+	u_int32_t duplicates;		/* retries of an MPDU seen in the window */
+
+	/* transmitter of the last frame charged to one, for re-costing */
+	struct station_entry *last_station;
+};
+
+void retry_stats_init(struct retry_stats *rs, struct arena *arena);
+
+int retry_stats_account(struct retry_stats *rs, const u_int8_t *ta,
+						int has_seq, u_int16_t seq_ctrl, int tid,
+						u_int8_t retry_bit, int duration);
+
+void retry_stats_adjust(struct retry_stats *rs, int flags, int ac, int adjust);
+
+void retry_stats_report(const struct retry_stats *rs, FILE *out);
+
+int retry_stats_save(const struct retry_stats *rs, FILE *fp);
+
+int retry_stats_load(struct retry_stats *rs, FILE *fp);
+
+void retry_stats_reset(struct retry_stats *rs);
+
+#endif
@@ -0,0 +1,166 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sampler.h"
+#include "radiotap_view.h"
+
+#define SAMPLER_SEED 0x9e3779b97f4a7c15ULL	/* runs are reproducible */
+
+/* xorshift64* */
+static u_int64_t next_random(struct sampler *s){
+	s->rng ^= s->rng >> 12;
+	s->rng ^= s->rng << 25;
+	s->rng ^= s->rng >> 27;
+	return s->rng * 0x2545f4914f6cdd1dULL;
+}
+
+/**
+ * sampler_init - disable sampling and clear the estimator.
+ * @s: sampler.
+ */
+void sampler_init(struct sampler *s){
+	memset(s, 0, sizeof(*s));
+	s->rng = SAMPLER_SEED;
+}
+
+/**
+ * sampler_parse - configure the sampler.
+ * @s: sampler.
+ * @spec: "N" to sample 1 PPDU in N, or "ON/PERIOD" to sample the PPDUs
+ * starting in the first ON milliseconds of every PERIOD milliseconds.
+ *
+ * Return: 0 on success, -1 if @spec is malformed.
+ */
+int sampler_parse(struct sampler *s, const char *spec){
+	unsigned int a, b;
+	char end;
+
+	switch (sscanf(spec, "%u/%u%c", &a, &b, &end)){
+		case 1:
+			if (a == 0)
+				return -1;
+			s->mode = a > 1 ? SAMPLE_COUNT : SAMPLE_OFF;
+			s->one_in = a;
+			return 0;
+		case 2:
+			if (a == 0 || b == 0 || a > b)
+				return -1;
+			s->mode = a < b ? SAMPLE_TIME : SAMPLE_OFF;
+			s->on_usec = (u_int64_t)a * 1000;
+			s->period_usec = (u_int64_t)b * 1000;
+			return 0;
+	}
+	return -1;
+}
+
+/**
+ * close_ppdu - add the airtime of the PPDU just ended to the estimator.
+ * @s: sampler.
+ * @airtime: analyzer airtime now.
+ */
+static void close_ppdu(struct sampler *s, u_int64_t airtime){
+	double y;
+
+	if (!s->taking)
+		return;
+	y = (double)(airtime - s->start_airtime);
+	s->sum += y;
+	s->sum_sq += y * y;
+	s->taking = 0;
+}
+
+/**
+ * sampler_take - decide whether a frame is analyzed.
+ * Called first thing for every frame, on the frame in place.
+ * @s: sampler.
+ * @rtap: radiotap header.
+ * @caplen: captured bytes from @rtap.
+ * @ts_usec: capture time stamp.
+ * @airtime: analyzer airtime so far.
+ *
+ * Return: 1 to analyze the frame, 0 to skip it.
+ */
+int sampler_take(struct sampler *s, const u_int8_t *rtap, unsigned int caplen,
+				 u_int64_t ts_usec, u_int64_t airtime){
+	u_int64_t tsf = 0;
+	u_int8_t has_tsf = rtap_peek_tsft(rtap, caplen, &tsf);
+	u_int8_t same_ppdu;
+
+	if (s->mode == SAMPLE_OFF)
+		return 1;
+
+	/* the continuation patterns of in_ampdu() */
+	same_ppdu = s->has_prev && has_tsf && s->prev_has_tsf &&
+				(tsf == s->prev_tsf ||
+				 (tsf == 0 && s->prev_tsf != 0) ||
+				 s->prev_tsf == 0xffffffffffffffffULL);
+	s->has_prev = 1;
+	s->prev_has_tsf = has_tsf;
+	s->prev_tsf = tsf;
+
+	if (!same_ppdu){
+		close_ppdu(s, airtime);
+		s->ppdus++;
+		if (s->mode == SAMPLE_COUNT)
+			s->taking = next_random(s) % s->one_in == 0;
+		else
+			s->taking = ts_usec % s->period_usec < s->on_usec;
+		if (s->taking){
+			s->sampled++;
+			s->start_airtime = airtime;
+		}
+	}
+	if (!s->taking)
+		s->skipped_frames++;
+	return s->taking;
+}
+
+/**
+ * sampler_finish - close the last PPDU at the end of the capture.
+ * @s: sampler.
+ * @airtime: analyzer airtime.
+ */
+void sampler_finish(struct sampler *s, u_int64_t airtime){
+	close_ppdu(s, airtime);
+}
+
+/**
+ * sampler_estimate - estimated total airtime.
+ * @s: sampler.
+ * @half_width: half width of the 95% confidence interval.
+ *
+ * Return: the estimate (microseconds).
+ */
+double sampler_estimate(const struct sampler *s, double *half_width){
+	double n = s->sampled, m = s->ppdus;
+	double mean, var;
+
+	*half_width = 0;
+	if (s->sampled == 0)
+		return 0;
+	mean = s->sum / n;
+	if (s->sampled > 1){
+		var = (s->sum_sq - n * mean * mean) / (n - 1);
+		if (var < 0)
+			var = 0;
+		/* finite population correction */
+		*half_width = 1.96 * m * sqrt((1 - n / m) * var / n);
+	}
+	return m * mean;
+}
+
+/**
+ * sampler_report - print the estimate and its confidence interval.
+ * @s: sampler.
+ * @out: report stream.
+ */
+void sampler_report(const struct sampler *s, FILE *out){
+	double half_width;
+	double estimate = sampler_estimate(s, &half_width);
+
+	fprintf(out, "sampled %llu of %llu PPDUs (%llu frames skipped)\n",
+			(unsigned long long)s->sampled, (unsigned long long)s->ppdus,
+			(unsigned long long)s->skipped_frames);
+	fprintf(out, "estimated airtime: %.0f us, 95%% confidence interval %.0f to %.0f us\n",
+			estimate, estimate - half_width, estimate + half_width);
+}
@@ -0,0 +1,59 @@
+#ifndef _SAMPLER_H
+#define _SAMPLER_H
+
+#include <stdio.h>
+#include <sys/types.h>
+
+#define SAMPLE_OFF   0
+#define SAMPLE_COUNT 1	/* each PPDU with probability 1/N */
+#define SAMPLE_TIME  2	/* PPDUs starting in the first part of each period */
+
+/*
+ * PPDU sampler.
+ * The unit of sampling is the PPDU, not the frame: all subframes of an
+ * A-MPDU are taken or skipped together, so in_ampdu() sees whole
+ * aggregates. PPDU boundaries are found from the radiotap TSFT alone,
+ * with the same patterns in_ampdu() uses, before anything else of the
+ * frame is decoded.
+ *
+ * The total airtime is estimated as (PPDUs seen) x (mean airtime of a
+ * sampled PPDU), with a normal 95% confidence interval that assumes
+ * PPDUs are sampled at random: exact for SAMPLE_COUNT, approximate for
+ * SAMPLE_TIME when traffic is not in step with the period.
+ */
+struct sampler {
+	/* configuration */
+	u_int8_t mode;
+	u_int32_t one_in;			/* SAMPLE_COUNT */
+	u_int64_t on_usec;			/* SAMPLE_TIME */
+	u_int64_t period_usec;
+	u_int64_t rng;
+
+	/* current PPDU */
+	u_int8_t has_prev;
+	u_int8_t prev_has_tsf;
+	u_int64_t prev_tsf;
+	u_int8_t taking;			/* current PPDU is sampled */
+	u_int64_t start_airtime;	/* analyzer airtime when it started */
+
+	/* estimator */
+	u_int64_t ppdus;			/* seen */
+	u_int64_t sampled;
+	u_int64_t skipped_frames;
+	double sum, sum_sq;			/* airtime of the sampled PPDUs */
+};
+
+void sampler_init(struct sampler *s);
+
+int sampler_parse(struct sampler *s, const char *spec);
+
+int sampler_take(struct sampler *s, const u_int8_t *rtap, unsigned int caplen,
+				 u_int64_t ts_usec, u_int64_t airtime);
+
+void sampler_finish(struct sampler *s, u_int64_t airtime);
+
+double sampler_estimate(const struct sampler *s, double *half_width);
+
+void sampler_report(const struct sampler *s, FILE *out);
+
+#endif
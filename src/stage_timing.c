@@ -0,0 +1,97 @@
+#include "stage_timing.h"
+
+#ifdef STAGE_TIMING
+
+#include <string.h>
+
+__thread struct stage_timing *stage_local;
+volatile sig_atomic_t stage_report_requested = 0;
+
+static struct stage_timing accumulators[STAGE_MAX_THREADS];
+static struct stage_timing overflow;	/* threads past STAGE_MAX_THREADS */
+static unsigned int n_accumulators;
+
+static u_int64_t start_ticks;
+static struct timespec start_time;
+
+static const char *stage_names[STAGE_COUNT] = {
+	"pcap_dump", "radiotap", "classify", "in_ampdu", "duration", "account"
+};
+
+static void report_handler(int sig){
+	stage_report_requested = 1;
+}
+
+/**
+ * stage_timing_register - give the calling thread its accumulator.
+ *
+ * Return: the accumulator.
+ */
+struct stage_timing *stage_timing_register(void){
+	unsigned int i = __atomic_fetch_add(&n_accumulators, 1, __ATOMIC_RELAXED);
+
+	/* threads beyond the table share one, their counts are approximate */
+	if (i >= STAGE_MAX_THREADS)
+		return &overflow;
+	return &accumulators[i];
+}
+
+/**
+ * stage_timing_init - start the clock and report on SIGUSR1.
+ */
+void stage_timing_init(void){
+	struct sigaction sa;
+
+	clock_gettime(CLOCK_MONOTONIC, &start_time);
+	start_ticks = stage_clock();
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = report_handler;
+	sa.sa_flags = SA_RESTART;
+	sigaction(SIGUSR1, &sa, NULL);
+}
+
+/**
+ * stage_timing_report - print the time per frame of every stage, summed
+ * over all threads.
+ * @out: report stream.
+ */
+void stage_timing_report(FILE *out){
+	u_int64_t ticks[STAGE_COUNT] = { 0 };
+	u_int64_t frames = 0, total = 0, elapsed_ticks;
+	unsigned int n = __atomic_load_n(&n_accumulators, __ATOMIC_RELAXED);
+	struct timespec now;
+	double ns_per_tick, elapsed_ns;
+	unsigned int i, s;
+
+	if (n > STAGE_MAX_THREADS)
+		n = STAGE_MAX_THREADS;
+	for (i = 0; i <= n; i++){
+		const struct stage_timing *acc = i < n ? &accumulators[i] : &overflow;
+
+		frames += __atomic_load_n(&acc->frames, __ATOMIC_RELAXED);
+		for (s = 0; s < STAGE_COUNT; s++)
+			ticks[s] += __atomic_load_n(&acc->ticks[s], __ATOMIC_RELAXED);
+	}
+	for (s = 0; s < STAGE_COUNT; s++)
+		total += ticks[s];
+
+	/* ticks to nanoseconds, from the time elapsed since init */
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	elapsed_ticks = stage_clock() - start_ticks;
+	elapsed_ns = (now.tv_sec - start_time.tv_sec) * 1e9 +
+				 (now.tv_nsec - start_time.tv_nsec);
+	ns_per_tick = elapsed_ticks ? elapsed_ns / elapsed_ticks : 1.0;
+
+	fprintf(out, "stage timing: %llu frames, %u threads\n",
+			(unsigned long long)frames, n);
+	if (frames == 0)
+		return;
+	for (s = 0; s < STAGE_COUNT; s++)
+		fprintf(out, "  %-10s %10.1f ns/frame %5.1f%%\n", stage_names[s],
+				ticks[s] * ns_per_tick / frames,
+				total ? 100.0 * ticks[s] / total : 0.0);
+	fprintf(out, "  %-10s %10.1f ns/frame\n", "total", total * ns_per_tick / frames);
+}
+
+#endif
@@ -0,0 +1,102 @@
+#ifndef _STAGE_TIMING_H
+#define _STAGE_TIMING_H
+
+/*
+ * Per-stage timing of got_packet(), built with STAGE_TIMING defined
+ * (make STAGE_TIMING=1). Otherwise every macro below expands to nothing.
+ *
+ * Each thread accumulates into its own counters; STAGE_END() charges the
+ * time since the previous mark to a stage. The clock is the TSC on x86,
+ * converted to nanoseconds at report time, and CLOCK_MONOTONIC elsewhere.
+ */
+
+#ifdef STAGE_TIMING
+
+#include <stdio.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+enum pipeline_stage {
+	STAGE_DUMP,			/* pcap_dump */
+	STAGE_RADIOTAP,		/* radiotap iteration */
+	STAGE_CLASSIFY,		/* PHY classification */
+	STAGE_AMPDU,		/* in_ampdu and first subframe re-costing */
+	STAGE_DURATION,		/* calculate_duration */
+	STAGE_ACCOUNT,		/* statistics and frame log */
+	STAGE_COUNT
+};
+
+#define STAGE_MAX_THREADS 64
+
+struct stage_timing {
+	u_int64_t ticks[STAGE_COUNT];
+	u_int64_t frames;
+};
+
+extern __thread struct stage_timing *stage_local;
+extern volatile sig_atomic_t stage_report_requested;
+
+struct stage_timing *stage_timing_register(void);
+
+void stage_timing_init(void);
+
+void stage_timing_report(FILE *out);
+
+static inline u_int64_t stage_clock(void){
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u_int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+static inline struct stage_timing *stage_acc(void){
+	if (stage_local == NULL)
+		stage_local = stage_timing_register();
+	return stage_local;
+}
+
+/* single writer per accumulator; relaxed stores let the reporter read it */
+static inline void stage_add(u_int64_t *counter, u_int64_t v){
+	__atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + v,
+					 __ATOMIC_RELAXED);
+}
+
+static inline u_int64_t stage_begin(void){
+	if (stage_report_requested){
+		stage_report_requested = 0;
+		stage_timing_report(stderr);
+	}
+	stage_add(&stage_acc()->frames, 1);
+	return stage_clock();
+}
+
+#define STAGE_START(t) u_int64_t t = stage_begin()
+/* a mark that does not count a frame, for a stage ahead of STAGE_START() */
+#define STAGE_MARK(t) u_int64_t t = stage_clock()
+#define STAGE_END(t, stage) do { \
+		u_int64_t _now = stage_clock(); \
+		stage_add(&stage_acc()->ticks[stage], _now - (t)); \
+		(t) = _now; \
+	} while (0)
+#define STAGE_INIT() stage_timing_init()
+#define STAGE_REPORT(out) stage_timing_report(out)
+
+#else
+
+#define STAGE_START(t)
+#define STAGE_MARK(t)
+#define STAGE_END(t, stage)
+#define STAGE_INIT()
+#define STAGE_REPORT(out)
+
+#endif
+
+#endif
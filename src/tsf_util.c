@@ -0,0 +1,191 @@
+#include <stdlib.h>
+#include <string.h>
+#include "tsf_util.h"
+
+/**
+ * tsf_util_init - forget the TSF history and clear the counters.
+ * @u: utilization.
+ * @ref: TSF_REF_* convention of the driver for frames that carry a TSF.
+ */
+void tsf_util_init(struct tsf_util *u, u_int8_t ref){
+	memset(u, 0, sizeof(*u));
+	u->ref = ref;
+}
+
+/**
+ * place - add an on-air interval to the busy time.
+ * Intervals come in capture order, so everything before the cursor is
+ * already counted: only the part past it is new busy time.
+ * @u: utilization.
+ * @start: unwrapped TSF of the first bit.
+ * @end: unwrapped TSF past the last bit.
+ */
+static void place(struct tsf_util *u, u_int64_t start, u_int64_t end){
+	if (start < u->cursor){
+		u->cur.overlap += (end < u->cursor ? end : u->cursor) - start;
+		u->cur.overlaps++;
+	}
+	if (end > u->cursor){
+		u->cur.busy += end - (start > u->cursor ? start : u->cursor);
+		u->cursor = end;
+	}
+	u->last = TSF_LAST_PLACED;
+	u->last_end = end;
+}
+
+/**
+ * check_jump - unwrap the TSF and detect resets, against the capture
+ * clock.
+ * @u: utilization.
+ * @tsf: TSF of the frame, not a placeholder.
+ * @ts: capture timestamp (us) of the frame.
+ *
+ * Return: 1 if the TSF jumped and a new segment starts.
+ */
+static int check_jump(struct tsf_util *u, u_int64_t tsf, u_int64_t ts){
+	int64_t d_cap = (int64_t)(ts - u->ts_prev);
+	int64_t d_tsf = (int64_t)(tsf - u->raw_prev);
+
+	if (tsf < u->raw_prev && u->raw_prev < TSF_32BIT_WRAP &&
+		llabs((int64_t)(tsf + TSF_32BIT_WRAP - u->raw_prev) - d_cap) <= TSF_RESET_SLACK){
+		u->wrap_offset += TSF_32BIT_WRAP;
+		u->cur.wraps++;
+		return 0;
+	}
+	if (llabs(d_tsf - d_cap) <= TSF_RESET_SLACK)
+		return 0;
+
+	/* reset (or a jump of the TSF): close the segment */
+	u->cur.span += u->cursor - u->seg_start;
+	u->cur.resets++;
+	u->wrap_offset = 0;
+	return 1;
+}
+
+/**
+ * tsf_util_adjust - add airtime to the last frame, it moves the end of
+ * the frame and may extend the busy time.
+ * @u: utilization.
+ * @adjust: airtime to add.
+ */
+void tsf_util_adjust(struct tsf_util *u, unsigned int adjust){
+	if (u->last == TSF_LAST_PENDING)
+		u->pending += adjust;
+	else if (u->last == TSF_LAST_PLACED){
+		u->last_end += adjust;
+		if (u->last_end > u->cursor){
+			u->cur.busy += u->last_end - u->cursor;
+			u->cursor = u->last_end;
+		}
+	}
+}
+
+/**
+ * tsf_util_frame - place a frame on the TSF time line.
+ * @u: utilization.
+ * @has_tsf: equal 1 if the frame has a radiotap TSFT.
+ * @tsf: the TSFT.
+ * @ts: capture timestamp (us).
+ * @airtime: duration of the frame.
+ */
+void tsf_util_frame(struct tsf_util *u, u_int8_t has_tsf, u_int64_t tsf,
+					u_int64_t ts, int airtime){
+	u_int64_t start, end, t;
+	u_int32_t held;
+	int new_segment = 0;
+
+	if (!has_tsf || (!u->started && tsf == TSF_NONE_ZERO)){
+		u->cur.no_tsf++;
+		u->last = TSF_LAST_OTHER;
+		return;
+	}
+	if (tsf == TSF_NONE_ONES){
+		/* QCA: placed once the last subframe gives the end of the PPDU */
+		u->pending += airtime;
+		u->last = TSF_LAST_PENDING;
+		return;
+	}
+
+	held = u->pending;
+	u->pending = 0;
+	if (u->started && (tsf == TSF_NONE_ZERO || tsf == u->raw_prev)){
+		/* next subframe of the same PPDU */
+		start = u->last_end;
+		end = start + held + airtime;
+	}
+	else {
+		if (u->started)
+			new_segment = check_jump(u, tsf, ts);
+		u->raw_prev = tsf;
+		u->ts_prev = ts;
+		t = tsf + u->wrap_offset;
+		if (held || u->ref == TSF_REF_END){
+			/* a TSF after held subframes refers to the end of the PPDU */
+			end = t;
+			start = t > held + airtime ? t - held - airtime : 0;
+		}
+		else {
+			start = t;
+			end = t + airtime;
+		}
+	}
+
+	if (!u->started || new_segment){
+		u->started = 1;
+		u->seg_start = start;
+		u->cursor = start;
+	}
+	place(u, start, end);
+}
+
+/**
+ * tsf_util_totals - busy and covered TSF time of the whole capture so far.
+ * @u: utilization.
+ * @busy: receives the busy time (us).
+ * @span: receives the TSF time covered (us).
+ */
+void tsf_util_totals(const struct tsf_util *u, u_int64_t *busy, u_int64_t *span){
+	*busy = u->total.busy + u->cur.busy;
+	*span = u->total.span + u->cur.span + (u->started ? u->cursor - u->seg_start : 0);
+}
+
+/**
+ * tsf_util_report - print the utilization of the interval.
+ * @u: utilization.
+ * @out: report stream.
+ */
+void tsf_util_report(const struct tsf_util *u, FILE *out){
+	u_int64_t span = u->cur.span + (u->started ? u->cursor - u->seg_start : 0);
+
+	if (span == 0)
+		return;
+	fprintf(out, "  utilization: busy %llu us of %llu us TSF time (%.1f%%)",
+			(unsigned long long)u->cur.busy, (unsigned long long)span,
+			100.0 * u->cur.busy / span);
+	if (u->cur.overlaps)
+		fprintf(out, "; %u overlapping frames, %llu us counted once",
+				u->cur.overlaps, (unsigned long long)u->cur.overlap);
+	if (u->cur.resets || u->cur.wraps)
+		fprintf(out, "; %u TSF resets, %u wraps", u->cur.resets, u->cur.wraps);
+	if (u->cur.no_tsf)
+		fprintf(out, "; %u frames without TSF", u->cur.no_tsf);
+	fprintf(out, "\n");
+}
+
+/**
+ * tsf_util_reset - start a new interval, the TSF history is kept.
+ * @u: utilization.
+ */
+void tsf_util_reset(struct tsf_util *u){
+	struct tsf_util_counters *t = &u->total;
+
+	t->busy += u->cur.busy;
+	t->span += u->cur.span + (u->started ? u->cursor - u->seg_start : 0);
+	t->overlap += u->cur.overlap;
+	t->overlaps += u->cur.overlaps;
+	t->resets += u->cur.resets;
+	t->wraps += u->cur.wraps;
+	t->no_tsf += u->cur.no_tsf;
+	memset(&u->cur, 0, sizeof(u->cur));
+	u->seg_start = u->cursor;
+}
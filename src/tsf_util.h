@@ -0,0 +1,84 @@
+#ifndef _TSF_UTIL_H
+#define _TSF_UTIL_H
+
+#include <stdio.h>
+#include <sys/types.h>
+
+/* what the radiotap TSFT of a frame refers to */
+#define TSF_REF_START 0		/* first bit of the PPDU (radiotap default) */
+#define TSF_REF_END   1		/* end of the PPDU */
+
+/* driver placeholders for subframes without a TSF of their own */
+#define TSF_NONE_ZERO 0ULL	/* TSF given on the first subframe only */
+#define TSF_NONE_ONES (~0ULL)	/* TSF given on the last subframe only */
+
+/* what became of the last frame, for its re-costing */
+#define TSF_LAST_OTHER    0	/* not placed */
+#define TSF_LAST_PLACED   1	/* placed, ends at last_end */
+#define TSF_LAST_PENDING  2	/* held for the subframe with the TSF */
+
+#define TSF_RESET_SLACK 1000000	/* us, TSF and capture clock may drift apart
+								   by this much before the TSF is taken as reset */
+#define TSF_32BIT_WRAP  (1ULL << 32)	/* drivers with a 32-bit TSF */
+
+struct tsf_util_counters {
+	u_int64_t busy;				/* us of TSF time with a frame on air */
+	u_int64_t span;				/* us of TSF time covered */
+	u_int64_t overlap;			/* us of frames already counted as busy */
+	u_int32_t overlaps;			/* frames overlapping the busy time */
+	u_int32_t resets;			/* TSF jumps, a new segment started */
+	u_int32_t wraps;			/* 32-bit TSF wraps */
+	u_int32_t no_tsf;			/* frames without TSF, not placed */
+};
+
+/*
+ * Channel utilization from on-air TSF timestamps: the busy time (union
+ * of the frames' on-air intervals) over the TSF time the capture covers.
+ * Each frame with a TSF gets an interval [start, end) of its airtime,
+ * placed by the driver's convention; subframes stamped with a
+ * placeholder (same TSF, 0 or all ones) follow the previous subframe,
+ * or are held until the subframe that carries the TSF. Busy time only
+ * grows past the end of what was already counted, so overlapping frames
+ * are counted once. 32-bit wraps are unwrapped and any other TSF jump
+ * away from the capture clock starts a new segment. State is O(1).
+ */
+struct tsf_util {
+	u_int8_t ref;				/* TSF_REF_* */
+
+	u_int8_t started;			/* a frame was placed */
+	u_int8_t last;				/* what became of the last frame, TSF_LAST_* */
+	u_int64_t raw_prev;			/* last TSF that was not a placeholder */
+	u_int64_t ts_prev;			/* its capture timestamp (us) */
+	u_int64_t wrap_offset;		/* added to the raw TSF */
+	u_int64_t last_end;			/* end of the last frame, unwrapped TSF */
+	u_int64_t cursor;			/* end of the busy time counted */
+	u_int64_t seg_start;		/* start of the segment in this interval */
+	u_int32_t pending;			/* airtime of subframes waiting for a TSF */
+
+	struct tsf_util_counters cur;	/* this interval, span of closed segments */
+	struct tsf_util_counters total;	/* previous intervals */
+};
+
+void tsf_util_init(struct tsf_util *u, u_int8_t ref);
+
+void tsf_util_frame(struct tsf_util *u, u_int8_t has_tsf, u_int64_t tsf,
+					u_int64_t ts, int airtime);
+
+void tsf_util_adjust(struct tsf_util *u, unsigned int adjust);
+
+/**
+ * tsf_util_forget - drop held subframes, when the frames that follow are
+ * not analyzed.
+ * @u: utilization.
+ */
+static inline void tsf_util_forget(struct tsf_util *u){
+	u->pending = 0;
+}
+
+void tsf_util_totals(const struct tsf_util *u, u_int64_t *busy, u_int64_t *span);
+
+void tsf_util_report(const struct tsf_util *u, FILE *out);
+
+void tsf_util_reset(struct tsf_util *u);
+
+#endif
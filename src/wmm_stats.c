@@ -0,0 +1,63 @@
+#include <string.h>
+#include "wmm_stats.h"
+
+const char *ac_names[AC_COUNT] = { "AC_BK", "AC_BE", "AC_VI", "AC_VO", "other" };
+
+/**
+ * wmm_stats_init - clear the counters.
+ * @ws: WMM stats.
+ */
+void wmm_stats_init(struct wmm_stats *ws){
+	memset(ws, 0, sizeof(*ws));
+}
+
+/**
+ * wmm_stats_account - charge a frame to its access category.
+ * @ws: WMM stats.
+ * @ac: AC_* of the frame.
+ * @duration: airtime of the frame.
+ */
+void wmm_stats_account(struct wmm_stats *ws, int ac, int duration){
+	ws->ac[ac].airtime += duration;
+	ws->ac[ac].frames++;
+}
+
+/**
+ * wmm_stats_adjust - change the airtime of a frame already accounted.
+ * @ws: WMM stats.
+ * @ac: AC_* the frame was accounted with.
+ * @adjust: airtime to add.
+ */
+void wmm_stats_adjust(struct wmm_stats *ws, int ac, int adjust){
+	ws->ac[ac].airtime += adjust;
+}
+
+/**
+ * wmm_stats_report - print the airtime of each access category.
+ * @ws: WMM stats.
+ * @out: report stream.
+ */
+void wmm_stats_report(const struct wmm_stats *ws, FILE *out){
+	u_int64_t total = 0;
+	int i;
+
+	for (i = 0; i < AC_COUNT; i++)
+		total += ws->ac[i].airtime;
+	/* highest priority first */
+	for (i = AC_VO; i >= AC_BK; i--)
+		fprintf(out, "  %s: airtime %llu us (%.1f%%), %u frames\n", ac_names[i],
+				(unsigned long long)ws->ac[i].airtime,
+				total ? 100.0 * ws->ac[i].airtime / total : 0.0, ws->ac[i].frames);
+	fprintf(out, "  non-QoS/TSPEC: airtime %llu us (%.1f%%), %u frames\n",
+			(unsigned long long)ws->ac[AC_OTHER].airtime,
+			total ? 100.0 * ws->ac[AC_OTHER].airtime / total : 0.0,
+			ws->ac[AC_OTHER].frames);
+}
+
+/**
+ * wmm_stats_reset - start a new interval.
+ * @ws: WMM stats.
+ */
+void wmm_stats_reset(struct wmm_stats *ws){
+	wmm_stats_init(ws);
+}
@@ -0,0 +1,49 @@
+#ifndef _WMM_STATS_H
+#define _WMM_STATS_H
+
+#include <stdio.h>
+#include <sys/types.h>
+#include "channel_stats.h"
+
+/* WMM access categories */
+#define AC_BK    0
+#define AC_BE    1
+#define AC_VI    2
+#define AC_VO    3
+#define AC_OTHER 4	/* non-QoS frames and TSPEC streams (TID 8 to 15) */
+#define AC_COUNT 5
+
+extern const char *ac_names[AC_COUNT];
+
+/**
+ * tid_to_ac - access category of a QoS TID (802.1D user priority).
+ * @tid: TID, -1 for non-QoS frames.
+ *
+ * Return: AC_*.
+ */
+static inline int tid_to_ac(int tid){
+	static const u_int8_t up_to_ac[8] = {
+		AC_BE, AC_BK, AC_BK, AC_BE, AC_VI, AC_VI, AC_VO, AC_VO
+	};
+
+	if (tid < 0 || tid > 7)
+		return AC_OTHER;
+	return up_to_ac[tid];
+}
+
+/* Airtime per access category over one interval */
+struct wmm_stats {
+	struct airtime_counter ac[AC_COUNT];
+};
+
+void wmm_stats_init(struct wmm_stats *ws);
+
+void wmm_stats_account(struct wmm_stats *ws, int ac, int duration);
+
+void wmm_stats_adjust(struct wmm_stats *ws, int ac, int adjust);
+
+void wmm_stats_report(const struct wmm_stats *ws, FILE *out);
+
+void wmm_stats_reset(struct wmm_stats *ws);
+
+#endif